@@ -22,10 +22,9 @@
 CLICK_DECLS
 
 BusynessTrigger::BusynessTrigger(int iface_id, uint32_t trigger_id,
-		empower_trigger_relation rel, int val, bool dispatched, uint16_t period,
+		empower_trigger_relation rel, int val, uint16_t period,
 		EmpowerLVAPManager * el, EmpowerRXStats * ers) :
-		Trigger(trigger_id, period, el, ers), _iface_id(iface_id), _rel(rel), _val(val),
-		_dispatched(dispatched) {
+		Trigger(trigger_id, period, el, ers), _iface_id(iface_id), _rel(rel), _val(val) {
 
 }
 
@@ -56,29 +55,26 @@ String BusynessTrigger::unparse() {
 		break;
 	}
 	sa << " val " << _val;
-	if (_dispatched) {
-		sa << " dispatched";
-	}
 	return sa.take_string();
 }
 
-bool BusynessTrigger::matches(const BusynessInfo* nfo) {
+bool BusynessTrigger::matches(int value) {
 	bool match = false;
 	switch (_rel) {
 	case EQ:
-		match = (nfo->_sma_busyness->avg() == _val);
+		match = (value == _val);
 		break;
 	case GT:
-		match = (nfo->_sma_busyness->avg() > _val);
+		match = (value > _val);
 		break;
 	case LT:
-		match = (nfo->_sma_busyness->avg() < _val);
+		match = (value < _val);
 		break;
 	case GE:
-		match = (nfo->_sma_busyness->avg() >= _val);
+		match = (value >= _val);
 		break;
 	case LE:
-		match = (nfo->_sma_busyness->avg() <= _val);
+		match = (value <= _val);
 		break;
 	}
 	return match;
@@ -15,14 +15,13 @@ public:
 	int _iface_id;
 	empower_trigger_relation _rel;
 	int _val;
-	bool _dispatched;
 
-	BusynessTrigger(int, uint32_t, empower_trigger_relation, int, bool, uint16_t, EmpowerLVAPManager *, EmpowerRXStats *);
+	BusynessTrigger(int, uint32_t, empower_trigger_relation, int, uint16_t, EmpowerLVAPManager *, EmpowerRXStats *);
 	~BusynessTrigger();
 
 	String unparse();
 
-	bool matches(const BusynessInfo * nfo);
+	bool matches(int value);
 
 	inline bool operator==(const BusynessTrigger &b) {
 		return (_iface_id == b._iface_id) && (_rel == b._rel) && (_val == b._val);
@@ -21,6 +21,7 @@ public:
     unsigned _silent_window_count;
 	int _iface_id;
 	Timestamp _last_updated;
+	Vector<uint32_t> _dispatched;
 
 	BusynessInfo() {
 		_last_packets = 0;
@@ -32,10 +33,58 @@ public:
 		_iface_id = -1;
 	}
 
+	BusynessInfo(const BusynessInfo &o) : _sma_busyness(0) {
+		*this = o;
+	}
+
 	~BusynessInfo() {
 		delete _sma_busyness;
 	}
 
+	// Deep copy: each BusynessInfo owns its SMA
+	BusynessInfo &operator=(const BusynessInfo &o) {
+		if (this == &o) {
+			return *this;
+		}
+		SMA *sma = o._sma_busyness ? new SMA(*o._sma_busyness) : 0;
+		delete _sma_busyness;
+		_last_busyness = o._last_busyness;
+		_accum_busyness = o._accum_busyness;
+		_last_packets = o._last_packets;
+		_sma_busyness = sma;
+		_packets = o._packets;
+		_silent_window_count = o._silent_window_count;
+		_iface_id = o._iface_id;
+		_last_updated = o._last_updated;
+		_dispatched = o._dispatched;
+		return *this;
+	}
+
+	// Hysteresis: triggers that already fired for this interface
+	bool dispatched(uint32_t trigger_id) const {
+		for (int i = 0; i < _dispatched.size(); i++) {
+			if (_dispatched[i] == trigger_id) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void set_dispatched(uint32_t trigger_id, bool dispatched) {
+		for (int i = 0; i < _dispatched.size(); i++) {
+			if (_dispatched[i] == trigger_id) {
+				if (!dispatched) {
+					_dispatched[i] = _dispatched.back();
+					_dispatched.pop_back();
+				}
+				return;
+			}
+		}
+		if (dispatched) {
+			_dispatched.push_back(trigger_id);
+		}
+	}
+
 	void update() {
 		Timestamp delta = Timestamp::now() - _last_updated;
 		_last_busyness = (_accum_busyness > 0) ? (_accum_busyness * 18000) / delta.usec() : 0;
@@ -52,6 +101,11 @@ public:
 		_accum_busyness += calc_usecs_wifi_packet(len, rate, 0);
 	}
 
+	void add_samples(int packets, uint32_t accum_busyness) {
+		_packets += packets;
+		_accum_busyness += accum_busyness;
+	}
+
 	String unparse() {
 		Timestamp now = Timestamp::now();
 		Timestamp age = now - _last_updated;
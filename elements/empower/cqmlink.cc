@@ -48,6 +48,7 @@ CqmLink::CqmLink() {
 	xi = 0;
 
     channel_busy_time = 0;
+    own_busy_time = 0;
     data_bits_recv = 0;
     channel_busy_fraction = 0;
     throughput = 0;
@@ -220,6 +221,10 @@ void CqmLink::add_cbt_sample(uint32_t usec) {
 	channel_busy_time += usec;
 }
 
+void CqmLink::add_own_cbt_sample(uint32_t usec) {
+	own_busy_time += usec;
+}
+
 String CqmLink::unparse() {
 	StringAccum sa;
 	sa << sourceAddr.unparse();
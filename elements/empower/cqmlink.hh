@@ -20,6 +20,7 @@ public:
 
 	void add_sample(uint32_t, uint8_t, uint16_t);
 	void add_cbt_sample(uint32_t);
+	void add_own_cbt_sample(uint32_t);
 
 	String unparse();
 
@@ -50,6 +51,7 @@ public:
 	uint16_t currentSeqNum;
 
     double channel_busy_time;
+    double own_busy_time; // airtime of this link's own frames in the current period
     double channel_busy_fraction;
     double data_bits_recv;
     double throughput;
@@ -24,6 +24,7 @@ public:
 	int _hist_packets;
 	int _iface_id;
 	Timestamp _last_received;
+	Vector<uint32_t> _dispatched;
 
 	DstInfo() {
 		_eth = EtherAddress();
@@ -40,10 +41,63 @@ public:
 		_iface_id = -1;
 	}
 
+	DstInfo(const DstInfo &o) : _sma_rssi(0) {
+		*this = o;
+	}
+
 	~DstInfo() {
 		delete _sma_rssi;
 	}
 
+	// Deep copy: each DstInfo owns its SMA
+	DstInfo &operator=(const DstInfo &o) {
+		if (this == &o) {
+			return *this;
+		}
+		SMA *sma = o._sma_rssi ? new SMA(*o._sma_rssi) : 0;
+		delete _sma_rssi;
+		_eth = o._eth;
+		_sender_type = o._sender_type;
+		_accum_rssi = o._accum_rssi;
+		_squares_rssi = o._squares_rssi;
+		_packets = o._packets;
+		_last_rssi = o._last_rssi;
+		_last_std = o._last_std;
+		_last_packets = o._last_packets;
+		_sma_rssi = sma;
+		_silent_window_count = o._silent_window_count;
+		_hist_packets = o._hist_packets;
+		_iface_id = o._iface_id;
+		_last_received = o._last_received;
+		_dispatched = o._dispatched;
+		return *this;
+	}
+
+	// Hysteresis: triggers that already fired for this neighbour
+	bool dispatched(uint32_t trigger_id) const {
+		for (int i = 0; i < _dispatched.size(); i++) {
+			if (_dispatched[i] == trigger_id) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void set_dispatched(uint32_t trigger_id, bool dispatched) {
+		for (int i = 0; i < _dispatched.size(); i++) {
+			if (_dispatched[i] == trigger_id) {
+				if (!dispatched) {
+					_dispatched[i] = _dispatched.back();
+					_dispatched.pop_back();
+				}
+				return;
+			}
+		}
+		if (dispatched) {
+			_dispatched.push_back(trigger_id);
+		}
+	}
+
 	void update() {
 		_hist_packets += _packets;
 		_last_rssi = (_packets > 0) ? _accum_rssi / (double) _packets : 0;
@@ -67,6 +121,15 @@ public:
 		_last_received.assign_now();
 	}
 
+	void add_samples(int packets, int accum_rssi, int squares_rssi, Timestamp last_received) {
+		_packets += packets;
+		_accum_rssi += accum_rssi;
+		_squares_rssi += squares_rssi;
+		if (last_received > _last_received) {
+			_last_received = last_received;
+		}
+	}
+
 	String unparse() {
 		Timestamp now = Timestamp::now();
 		StringAccum sa;
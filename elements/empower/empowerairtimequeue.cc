@@ -0,0 +1,584 @@
+/*
+ * empowerairtimequeue.{cc,hh} -- airtime-fair per-LVAP downlink queues
+ *
+ * Copyright (c) 2017 CREATE-NET
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "empowerairtimequeue.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <clicknet/wifi.h>
+#include <elements/wifi/bitrate.hh>
+#include <elements/wifi/minstrel.hh>
+CLICK_DECLS
+
+EmpowerAirtimeQueue::EmpowerAirtimeQueue() :
+	_rc(0), _sleepiness(0), _active_head(0), _active_tail(0),
+	_capacity(200), _quantum(1000), _length(0), _drops(0), _codel_drops(0),
+	_codel(true), _target(Timestamp::make_msec(0, 5)),
+	_interval(Timestamp::make_msec(0, 100)), _debug(false) {
+}
+
+EmpowerAirtimeQueue::~EmpowerAirtimeQueue() {
+	flush(&_default);
+	for (ASIter it = _stations.begin(); it.live(); it++) {
+		flush(it.value());
+		delete it.value();
+	}
+}
+
+void *
+EmpowerAirtimeQueue::cast(const char *n) {
+	if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+		return static_cast<Notifier *>(&_empty_note);
+	return Element::cast(n);
+}
+
+int EmpowerAirtimeQueue::configure(Vector<String> &conf, ErrorHandler *errh) {
+
+	_empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+
+	int ret = Args(conf, this, errh)
+			.read_mp("RC", ElementCastArg("Minstrel"), _rc)
+			.read("CAPACITY", _capacity)
+			.read("QUANTUM", _quantum)
+			.read("CODEL", _codel)
+			.read("TARGET", _target)
+			.read("INTERVAL", _interval)
+			.read("DEBUG", _debug)
+			.complete();
+
+	if (ret < 0)
+		return ret;
+
+	if (_capacity <= 0)
+		return errh->error("CAPACITY must be positive");
+
+	if (_quantum == 0)
+		return errh->error("QUANTUM must be positive");
+
+	if (!_interval)
+		return errh->error("INTERVAL must be positive");
+
+	_default._quantum = _quantum;
+
+	return ret;
+
+}
+
+AirtimeStation *EmpowerAirtimeQueue::get_station(EtherAddress dst) {
+
+	// only LVAPs get a queue of their own
+	if (dst.is_group()) {
+		return &_default;
+	}
+
+	AirtimeStation **st = _stations.get_pointer(dst);
+
+	return st ? *st : &_default;
+
+}
+
+uint32_t EmpowerAirtimeQueue::airtime(EtherAddress dst, int len) {
+
+	MinstrelDstInfo *nfo = dst.is_group() ? 0 : _rc->neighbors()->findp(dst);
+
+	// not sampled yet, use the first rate of the policy
+	if (!nfo || !nfo->nb_rates) {
+		TxPolicyInfo *txp = _rc->tx_policies()->lookup(dst);
+		int rate = txp ? txp->_first_mcs : 2;
+		return calc_usecs_wifi_packet(len, rate, 0);
+	}
+
+	int ndx = nfo->max_tp_rate;
+	int rate = nfo->rates[ndx];
+	uint32_t usecs = nfo->ht ? calc_usecs_wifi_packet_ht(len, rate, 0) : calc_usecs_wifi_packet(len, rate, 0);
+
+	// expected number of transmissions, at most 10
+	int prob = nfo->probability[ndx];
+	if (prob > 0) {
+		if (prob < 1800) {
+			prob = 1800;
+		}
+		usecs = ((uint64_t) usecs * 18000) / prob;
+	}
+
+	return usecs;
+
+}
+
+void EmpowerAirtimeQueue::activate(AirtimeStation *st) {
+	st->_active = true;
+	st->_next = 0;
+	if (_active_tail) {
+		_active_tail->_next = st;
+	} else {
+		_active_head = st;
+	}
+	_active_tail = st;
+}
+
+void EmpowerAirtimeQueue::flush(AirtimeStation *st) {
+	while (Packet *p = st->dequeue()) {
+		_length--;
+		p->kill();
+	}
+}
+
+void EmpowerAirtimeQueue::push(int, Packet *p) {
+
+	if (p->length() < sizeof(struct click_wifi)) {
+		p->kill();
+		return;
+	}
+
+	struct click_wifi *w = (struct click_wifi *) p->data();
+	EtherAddress dst = EtherAddress(w->i_addr1);
+
+	_lock.acquire();
+
+	AirtimeStation *st = get_station(dst);
+
+	if (st->_length >= _capacity) {
+		st->_drops++;
+		_drops++;
+		_lock.release();
+		if (_debug) {
+			click_chatter("%{element} :: %s :: queue full for %s, dropping",
+						  this,
+						  __func__,
+						  dst.unparse().c_str());
+		}
+		p->kill();
+		return;
+	}
+
+	p->set_timestamp_anno(Timestamp::now());
+	st->enqueue(p);
+	_length++;
+
+	if (!st->_active) {
+		activate(st);
+	}
+
+	_lock.release();
+
+	_empty_note.wake();
+
+}
+
+// Dequeue the head frame and track its sojourn time, ok_to_drop is set
+// once the sojourn time has been above target for a whole interval
+Packet *
+EmpowerAirtimeQueue::dequeue(AirtimeStation *st, const Timestamp &now, bool &ok_to_drop) {
+
+	ok_to_drop = false;
+
+	Packet *p = st->dequeue();
+
+	if (!p) {
+		st->_first_above_time = Timestamp();
+		return 0;
+	}
+
+	_length--;
+
+	Timestamp sojourn = now - p->timestamp_anno();
+	st->_sojourn.add(sojourn.usecval() > 0 ? sojourn.usecval() : 0);
+
+	if (sojourn < _target || !st->_length) {
+		// below target, or nothing left behind this frame
+		st->_first_above_time = Timestamp();
+	} else if (!st->_first_above_time) {
+		st->_first_above_time = now + _interval;
+	} else if (now >= st->_first_above_time) {
+		ok_to_drop = true;
+	}
+
+	return p;
+
+}
+
+void EmpowerAirtimeQueue::codel_drop(AirtimeStation *st, Packet *p) {
+	st->_codel_drops++;
+	_codel_drops++;
+	if (_debug) {
+		click_chatter("%{element} :: %s :: codel drop for %s, count %u",
+					  this,
+					  __func__,
+					  st->_sta.unparse().c_str(),
+					  st->_drop_count);
+	}
+	p->kill();
+}
+
+// CoDel as in RFC 8289, on the queue of a single station
+Packet *
+EmpowerAirtimeQueue::codel_dequeue(AirtimeStation *st, const Timestamp &now) {
+
+	bool ok_to_drop;
+	Packet *p = dequeue(st, now, ok_to_drop);
+
+	if (!p) {
+		st->_dropping = false;
+		return 0;
+	}
+
+	if (st->_dropping) {
+		if (!ok_to_drop) {
+			// sojourn time below target, leave the dropping state
+			st->_dropping = false;
+		}
+		while (st->_dropping && now >= st->_drop_next) {
+			codel_drop(st, p);
+			st->_drop_count++;
+			p = dequeue(st, now, ok_to_drop);
+			if (!p || !ok_to_drop) {
+				st->_dropping = false;
+			} else {
+				st->_drop_next = control_law(st->_drop_next, st->_drop_count);
+			}
+		}
+	} else if (ok_to_drop) {
+		codel_drop(st, p);
+		p = dequeue(st, now, ok_to_drop);
+		st->_dropping = true;
+		// resume from the previous drop rate if we left the dropping
+		// state recently
+		uint32_t delta = st->_drop_count - st->_last_count;
+		if (delta > 1 && now - st->_drop_next < _interval * 16) {
+			st->_drop_count = delta;
+		} else {
+			st->_drop_count = 1;
+		}
+		st->_drop_next = control_law(now, st->_drop_count);
+		st->_last_count = st->_drop_count;
+	}
+
+	return p;
+
+}
+
+// t + interval / sqrt(count)
+Timestamp EmpowerAirtimeQueue::control_law(const Timestamp &t, uint32_t count) {
+	uint64_t usecs = (uint64_t) _interval.usecval() * 16 / int_sqrt(count * 256);
+	return t + Timestamp::make_usec(usecs);
+}
+
+Packet *
+EmpowerAirtimeQueue::pull(int) {
+
+	Packet *p = 0;
+
+	_lock.acquire();
+
+	Timestamp now = Timestamp::now();
+
+	while (AirtimeStation *st = _active_head) {
+
+		// out of credit, top up and move to the back of the round
+		if (st->_deficit <= 0) {
+			st->_deficit += st->_quantum;
+			if (st != _active_tail) {
+				_active_head = st->_next;
+				st->_next = 0;
+				_active_tail->_next = st;
+				_active_tail = st;
+			}
+			continue;
+		}
+
+		if (_codel) {
+			p = codel_dequeue(st, now);
+		} else {
+			bool ok_to_drop;
+			p = dequeue(st, now, ok_to_drop);
+		}
+
+		if (p) {
+			EtherAddress dst = (st == &_default) ? EtherAddress(((struct click_wifi *) p->data())->i_addr1) : st->_sta;
+			uint32_t usecs = airtime(dst, p->length());
+			st->_deficit -= usecs;
+			st->_airtime += usecs;
+			st->_packets++;
+		}
+
+		if (!st->_length) {
+			// leave the round, a debt is carried over
+			_active_head = st->_next;
+			if (!_active_head) {
+				_active_tail = 0;
+			}
+			st->_next = 0;
+			st->_active = false;
+			if (st->_deficit > 0) {
+				st->_deficit = 0;
+			}
+		}
+
+		// CoDel may have emptied the queue, try the next station
+		if (p) {
+			break;
+		}
+
+	}
+
+	_lock.release();
+
+	if (p) {
+		_sleepiness = 0;
+	} else if (_sleepiness >= SLEEPINESS_TRIGGER) {
+		_empty_note.sleep();
+#if HAVE_MULTITHREAD
+		// push() might have woken the notifier in the meantime
+		if (_length) {
+			_empty_note.wake();
+		}
+#endif
+	} else {
+		++_sleepiness;
+	}
+
+	return p;
+
+}
+
+void EmpowerAirtimeQueue::add_station(EtherAddress sta, uint32_t quantum) {
+
+	_lock.acquire();
+
+	if (_stations.get_pointer(sta)) {
+		_lock.release();
+		return;
+	}
+
+	AirtimeStation *st = new AirtimeStation();
+	st->_sta = sta;
+	st->_quantum = quantum ? quantum : _quantum;
+	_stations.set(sta, st);
+
+	_lock.release();
+
+}
+
+void EmpowerAirtimeQueue::set_quantum(EtherAddress sta, uint32_t quantum) {
+	_lock.acquire();
+	AirtimeStation **st = _stations.get_pointer(sta);
+	if (st) {
+		(*st)->_quantum = quantum ? quantum : _quantum;
+	}
+	_lock.release();
+}
+
+void EmpowerAirtimeQueue::remove_station(EtherAddress sta) {
+
+	_lock.acquire();
+
+	AirtimeStation **ptr = _stations.get_pointer(sta);
+
+	if (!ptr) {
+		_lock.release();
+		return;
+	}
+
+	AirtimeStation *st = *ptr;
+
+	if (st->_active) {
+		AirtimeStation *prev = 0;
+		for (AirtimeStation *it = _active_head; it; prev = it, it = it->_next) {
+			if (it != st) {
+				continue;
+			}
+			if (prev) {
+				prev->_next = st->_next;
+			} else {
+				_active_head = st->_next;
+			}
+			if (_active_tail == st) {
+				_active_tail = prev;
+			}
+			break;
+		}
+	}
+
+	flush(st);
+	_stations.erase(sta);
+
+	_lock.release();
+
+	delete st;
+
+}
+
+bool EmpowerAirtimeQueue::station_stats(EtherAddress sta, AirtimeStation &stats) {
+
+	_lock.acquire();
+
+	AirtimeStation **ptr = _stations.get_pointer(sta);
+
+	if (ptr) {
+		stats = **ptr;
+		// the copy does not own the frames
+		stats._head = stats._tail = 0;
+		stats._next = 0;
+	}
+
+	_lock.release();
+
+	return ptr != 0;
+
+}
+
+enum {
+	H_DEBUG,
+	H_STATIONS,
+	H_LENGTH,
+	H_DROPS,
+	H_CODEL_DROPS,
+	H_CAPACITY,
+	H_QUANTUM,
+	H_CODEL,
+	H_TARGET,
+	H_INTERVAL
+};
+
+void EmpowerAirtimeQueue::unparse_station(StringAccum &sa, const AirtimeStation *st) {
+	sa << " length " << st->_length;
+	sa << " deficit " << st->_deficit;
+	sa << " quantum " << st->_quantum;
+	sa << " packets " << st->_packets;
+	sa << " airtime " << st->_airtime;
+	sa << " drops " << st->_drops;
+	sa << " codel_drops " << st->_codel_drops;
+	sa << " sojourn_p50 " << st->_sojourn.percentile(50);
+	sa << " sojourn_p90 " << st->_sojourn.percentile(90);
+	sa << " sojourn_p99 " << st->_sojourn.percentile(99) << "\n";
+}
+
+String EmpowerAirtimeQueue::read_handler(Element *e, void *thunk) {
+	EmpowerAirtimeQueue *td = (EmpowerAirtimeQueue *) e;
+	switch ((uintptr_t) thunk) {
+	case H_DEBUG:
+		return String(td->_debug) + "\n";
+	case H_STATIONS: {
+		StringAccum sa;
+		td->_lock.acquire();
+		AirtimeStation *st = &td->_default;
+		sa << "default";
+		unparse_station(sa, st);
+		for (ASIter it = td->_stations.begin(); it.live(); it++) {
+			st = it.value();
+			sa << st->_sta.unparse();
+			unparse_station(sa, st);
+		}
+		td->_lock.release();
+		return sa.take_string();
+	}
+	case H_LENGTH:
+		return String(td->_length) + "\n";
+	case H_DROPS:
+		return String(td->_drops) + "\n";
+	case H_CODEL_DROPS:
+		return String(td->_codel_drops) + "\n";
+	case H_CAPACITY:
+		return String(td->_capacity) + "\n";
+	case H_QUANTUM:
+		return String(td->_quantum) + "\n";
+	case H_CODEL:
+		return String(td->_codel) + "\n";
+	case H_TARGET:
+		return td->_target.unparse_interval() + "\n";
+	case H_INTERVAL:
+		return td->_interval.unparse_interval() + "\n";
+	default:
+		return String();
+	}
+}
+
+int EmpowerAirtimeQueue::write_handler(const String &in_s, Element *e, void *vparam, ErrorHandler *errh) {
+	EmpowerAirtimeQueue *f = (EmpowerAirtimeQueue *) e;
+	String s = cp_uncomment(in_s);
+	switch ((intptr_t) vparam) {
+	case H_DEBUG: {
+		bool debug;
+		if (!BoolArg().parse(s, debug))
+			return errh->error("debug parameter must be boolean");
+		f->_debug = debug;
+		break;
+	}
+	case H_CAPACITY: {
+		int capacity;
+		if (!IntArg().parse(s, capacity) || capacity <= 0)
+			return errh->error("capacity parameter must be a positive integer");
+		f->_capacity = capacity;
+		break;
+	}
+	case H_QUANTUM: {
+		uint32_t quantum;
+		if (!IntArg().parse(s, quantum) || quantum == 0)
+			return errh->error("quantum parameter must be a positive integer");
+		f->_quantum = quantum;
+		f->_default._quantum = quantum;
+		break;
+	}
+	case H_CODEL: {
+		bool codel;
+		if (!BoolArg().parse(s, codel))
+			return errh->error("codel parameter must be boolean");
+		f->_codel = codel;
+		break;
+	}
+	case H_TARGET: {
+		Timestamp target;
+		if (!cp_time(s, &target))
+			return errh->error("target parameter must be a time");
+		f->_target = target;
+		break;
+	}
+	case H_INTERVAL: {
+		Timestamp interval;
+		if (!cp_time(s, &interval) || !interval)
+			return errh->error("interval parameter must be a positive time");
+		f->_interval = interval;
+		break;
+	}
+	}
+	return 0;
+}
+
+void EmpowerAirtimeQueue::add_handlers() {
+	add_read_handler("debug", read_handler, (void *) H_DEBUG);
+	add_read_handler("stations", read_handler, (void *) H_STATIONS);
+	add_read_handler("length", read_handler, (void *) H_LENGTH);
+	add_read_handler("drops", read_handler, (void *) H_DROPS);
+	add_read_handler("codel_drops", read_handler, (void *) H_CODEL_DROPS);
+	add_read_handler("capacity", read_handler, (void *) H_CAPACITY);
+	add_read_handler("quantum", read_handler, (void *) H_QUANTUM);
+	add_read_handler("codel", read_handler, (void *) H_CODEL);
+	add_read_handler("target", read_handler, (void *) H_TARGET);
+	add_read_handler("interval", read_handler, (void *) H_INTERVAL);
+	add_write_handler("debug", write_handler, (void *) H_DEBUG);
+	add_write_handler("capacity", write_handler, (void *) H_CAPACITY);
+	add_write_handler("quantum", write_handler, (void *) H_QUANTUM);
+	add_write_handler("codel", write_handler, (void *) H_CODEL);
+	add_write_handler("target", write_handler, (void *) H_TARGET);
+	add_write_handler("interval", write_handler, (void *) H_INTERVAL);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(EmpowerAirtimeQueue)
+ELEMENT_REQUIRES(bitrate)
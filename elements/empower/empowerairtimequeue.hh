@@ -0,0 +1,288 @@
+// -*- mode: c++; c-basic-offset: 2 -*-
+#ifndef CLICK_EMPOWERAIRTIMEQUEUE_HH
+#define CLICK_EMPOWERAIRTIMEQUEUE_HH
+#include <click/config.h>
+#include <click/element.hh>
+#include <click/etheraddress.hh>
+#include <click/hashtable.hh>
+#include <click/integers.hh>
+#include <click/notifier.hh>
+#include <click/sync.hh>
+#include <click/timestamp.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+/*
+=c
+
+EmpowerAirtimeQueue(RC[, I<KEYWORDS>])
+
+=s EmPOWER
+
+Per-LVAP downlink queues served in airtime-fair order, with per-LVAP CoDel
+
+=d
+
+Push-to-pull queue for the 802.11 data frames of one interface. Frames
+addressed to an LVAP are queued per station, everything else (group
+frames, unknown stations) shares a default queue. Stations are served
+with deficit round robin where the deficit is accounted in microseconds
+of airtime: every dequeued frame is charged the time needed to send it
+at the rate currently picked by the rate control, scaled by the delivery
+probability Minstrel learnt from TX feedback. A station at 1 Mbps thus
+cannot starve the faster ones sharing the radio.
+
+Each LVAP queue runs its own CoDel state machine on the time its frames
+spent in that queue, so a bulk download only builds up delay (and gets
+its frames dropped) in its own queue and not in the queues of the other
+stations on the radio. Queues are created and destroyed by
+EmpowerLVAPManager when LVAPs are added and removed; the sojourn time
+distribution of every queue is kept for reporting.
+
+The quantum of an LVAP can be set by the controller, see
+EmpowerLVAPManager.
+
+Keyword arguments are:
+
+=over 8
+
+=item RC
+The Minstrel element of the interface
+
+=item CAPACITY
+Maximum number of frames queued for each station, default is 200
+
+=item QUANTUM
+Airtime (in usec) granted to a station at each round, default is 1000
+
+=item CODEL
+Boolean. Run CoDel on every station queue, default is true
+
+=item TARGET
+CoDel target sojourn time, default is 5ms
+
+=item INTERVAL
+CoDel interval, default is 100ms
+
+=item DEBUG
+Turn debug on/off
+
+=back 8
+
+=h stations read-only
+Queue length, deficit, quantum, frames, airtime (usec), drops, CoDel
+drops and 50th/90th/99th percentile of the sojourn time (usec) of every
+station
+
+=h length read-only
+Number of frames queued
+
+=h drops read-only
+Number of frames dropped because a station queue was full
+
+=h codel_drops read-only
+Number of frames dropped by CoDel
+
+=h codel read/write
+Whether CoDel is enabled
+
+=h target read/write
+CoDel target
+
+=h interval read/write
+CoDel interval
+
+=h capacity read/write
+Per-station capacity
+
+=h quantum read/write
+Default quantum (usec)
+
+=a EmpowerLVAPManager, Minstrel
+*/
+
+// Sojourn times in usec, four bins per power of two
+class SojournHistogram {
+public:
+
+	enum { NB_BINS = 96 };
+
+	uint32_t _bins[NB_BINS];
+	uint32_t _count;
+
+	SojournHistogram() {
+		reset();
+	}
+
+	void reset() {
+		memset(_bins, 0, sizeof(_bins));
+		_count = 0;
+	}
+
+	void add(uint32_t usec) {
+		_bins[bin(usec)]++;
+		_count++;
+	}
+
+	// upper bound of the bin holding the pct-th percentile
+	uint32_t percentile(int pct) const {
+		if (!_count) {
+			return 0;
+		}
+		uint64_t rank = ((uint64_t) _count * pct + 99) / 100;
+		uint64_t seen = 0;
+		for (int i = 0; i < NB_BINS; i++) {
+			seen += _bins[i];
+			if (seen >= rank) {
+				return bound(i);
+			}
+		}
+		return bound(NB_BINS - 1);
+	}
+
+	static int bin(uint32_t usec) {
+		if (usec < 4) {
+			return usec;
+		}
+		if (usec >= (1 << 25)) {
+			usec = (1 << 25) - 1;
+		}
+		int msb = 32 - ffs_msb(usec);
+		return (msb - 1) * 4 + ((usec >> (msb - 2)) & 3);
+	}
+
+	static uint32_t bound(int bin) {
+		if (bin < 4) {
+			return bin;
+		}
+		int msb = bin / 4 + 1;
+		return ((uint32_t) (5 + bin % 4) << (msb - 2)) - 1;
+	}
+};
+
+class AirtimeStation {
+public:
+	EtherAddress _sta;
+	Packet *_head;
+	Packet *_tail;
+	int _length;
+	int32_t _deficit; // usec
+	uint32_t _quantum; // usec
+	bool _active;
+	AirtimeStation *_next; // in the active list
+	uint32_t _packets;
+	uint64_t _airtime; // usec
+	uint32_t _drops;
+
+	// CoDel state
+	bool _dropping;
+	uint32_t _drop_count;
+	uint32_t _last_count;
+	Timestamp _first_above_time;
+	Timestamp _drop_next;
+	uint32_t _codel_drops;
+
+	SojournHistogram _sojourn;
+
+	AirtimeStation() :
+		_head(0), _tail(0), _length(0), _deficit(0), _quantum(0), _active(false),
+		_next(0), _packets(0), _airtime(0), _drops(0), _dropping(false),
+		_drop_count(0), _last_count(0), _codel_drops(0) {
+	}
+
+	void enqueue(Packet *p) {
+		p->set_next(0);
+		if (_tail) {
+			_tail->set_next(p);
+		} else {
+			_head = p;
+		}
+		_tail = p;
+		_length++;
+	}
+
+	Packet *dequeue() {
+		Packet *p = _head;
+		if (p) {
+			_head = p->next();
+			if (!_head) {
+				_tail = 0;
+			}
+			p->set_next(0);
+			_length--;
+		}
+		return p;
+	}
+};
+
+typedef HashTable<EtherAddress, AirtimeStation *> AirtimeStations;
+typedef AirtimeStations::iterator ASIter;
+
+class EmpowerAirtimeQueue: public Element {
+public:
+
+	EmpowerAirtimeQueue();
+	~EmpowerAirtimeQueue();
+
+	const char *class_name() const { return "EmpowerAirtimeQueue"; }
+	const char *port_count() const { return PORTS_1_1; }
+	const char *processing() const { return PUSH_TO_PULL; }
+	void *cast(const char *);
+
+	int configure(Vector<String> &, ErrorHandler *);
+	void add_handlers();
+
+	void push(int, Packet *);
+	Packet *pull(int);
+
+	void add_station(EtherAddress, uint32_t);
+	void set_quantum(EtherAddress, uint32_t);
+	void remove_station(EtherAddress);
+	bool station_stats(EtherAddress, AirtimeStation &);
+
+private:
+
+	class Minstrel *_rc;
+
+	SimpleSpinlock _lock;
+	ActiveNotifier _empty_note;
+	int _sleepiness;
+
+	AirtimeStations _stations;
+	AirtimeStation _default;
+
+	// stations with frames queued, served from the head
+	AirtimeStation *_active_head;
+	AirtimeStation *_active_tail;
+
+	int _capacity;
+	uint32_t _quantum;
+	int _length;
+	uint32_t _drops;
+	uint32_t _codel_drops;
+
+	bool _codel;
+	Timestamp _target;
+	Timestamp _interval;
+
+	bool _debug;
+
+	enum { SLEEPINESS_TRIGGER = 9 };
+
+	AirtimeStation *get_station(EtherAddress);
+	uint32_t airtime(EtherAddress, int);
+	void activate(AirtimeStation *);
+	void flush(AirtimeStation *);
+	Packet *dequeue(AirtimeStation *, const Timestamp &, bool &);
+	Packet *codel_dequeue(AirtimeStation *, const Timestamp &);
+	void codel_drop(AirtimeStation *, Packet *);
+	Timestamp control_law(const Timestamp &, uint32_t);
+
+	static int write_handler(const String &, Element *, void *, ErrorHandler *);
+	static String read_handler(Element *, void *);
+	static void unparse_station(StringAccum &, const AirtimeStation *);
+
+};
+
+CLICK_ENDDECLS
+#endif
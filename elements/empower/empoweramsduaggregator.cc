@@ -0,0 +1,364 @@
+/*
+ * empoweramsduaggregator.{cc,hh} -- software A-MSDU aggregation for HT LVAPs
+ *
+ * Copyright (c) 2017 CREATE-NET
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "empoweramsduaggregator.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/straccum.hh>
+#include <clicknet/wifi.h>
+#include <clicknet/llc.h>
+#include <elements/wifi/transmissionpolicy.hh>
+#include "empowerlvapmanager.hh"
+CLICK_DECLS
+
+// A-MSDU subframe header: DA, SA and the MSDU length
+#define AMSDU_SUBFRAME_HEADER_LEN 14
+
+// QoS control, first octet
+#define QOS_CTRL_AMSDU_PRESENT 0x80
+
+EmpowerAMSDUAggregator::EmpowerAMSDUAggregator() :
+	_el(0), _timer(this), _max_size(3839), _max_delay(Timestamp::make_msec(0, 1)),
+	_msdus(0), _passthrough(0), _amsdus(0), _aggregated(0), _debug(false) {
+}
+
+EmpowerAMSDUAggregator::~EmpowerAMSDUAggregator() {
+}
+
+int EmpowerAMSDUAggregator::configure(Vector<String> &conf, ErrorHandler *errh) {
+
+	int ret = Args(conf, this, errh)
+			.read_m("EL", ElementCastArg("EmpowerLVAPManager"), _el)
+			.read("MAX_SIZE", _max_size)
+			.read("MAX_DELAY", _max_delay)
+			.read("DEBUG", _debug)
+			.complete();
+
+	if (ret < 0)
+		return ret;
+
+	if (_max_size <= AMSDU_SUBFRAME_HEADER_LEN)
+		return errh->error("MAX_SIZE too small");
+
+	return ret;
+
+}
+
+int EmpowerAMSDUAggregator::initialize(ErrorHandler *) {
+	_timer.initialize(this);
+	return 0;
+}
+
+void EmpowerAMSDUAggregator::cleanup(CleanupStage) {
+	for (AMSDUIter it = _buffers.begin(); it.live(); it++) {
+		AMSDUBuffer *buf = &it.value();
+		while (Packet *p = buf->_head) {
+			buf->_head = p->next();
+			p->kill();
+		}
+		buf->_tail = 0;
+		buf->_count = 0;
+	}
+}
+
+bool EmpowerAMSDUAggregator::aggregable(EtherAddress dst) {
+	EmpowerStationState *ess = _el->get_ess(dst);
+	return ess && ess->_txp && ess->_txp->_ht_mcs.size();
+}
+
+void EmpowerAMSDUAggregator::push(int, Packet *p) {
+
+	if (p->length() < sizeof(struct click_wifi) + sizeof(struct click_llc)) {
+		output(0).push(p);
+		return;
+	}
+
+	struct click_wifi *w = (struct click_wifi *) p->data();
+	EtherAddress dst = EtherAddress(w->i_addr1);
+
+	// only plain unicast data frames
+	uint8_t type = w->i_fc[0] & (WIFI_FC0_TYPE_MASK | WIFI_FC0_SUBTYPE_MASK);
+
+	if (type != (WIFI_FC0_TYPE_DATA | WIFI_FC0_SUBTYPE_DATA) || dst.is_group()) {
+		output(0).push(p);
+		return;
+	}
+
+	AMSDUBuffer *buf = _buffers.get_pointer(dst);
+
+	_msdus++;
+
+	int subframe = AMSDU_SUBFRAME_HEADER_LEN + p->length() - sizeof(struct click_wifi);
+
+	if (subframe > _max_size || !aggregable(dst)) {
+		// keep the frames of this station in order
+		if (buf) {
+			flush(buf);
+			buf->_msdus++;
+			buf->_passthrough++;
+		}
+		_passthrough++;
+		output(0).push(p);
+		return;
+	}
+
+	// buffers are only created for stations that can aggregate
+	if (!buf) {
+		_buffers.set(dst, AMSDUBuffer());
+		buf = _buffers.get_pointer(dst);
+	}
+
+	buf->_msdus++;
+
+	// all subframes but the last are padded to 4 octets
+	int size = buf->_count ? ((buf->_size + 3) & ~3) + subframe : subframe;
+
+	if (size > _max_size) {
+		flush(buf);
+		size = subframe;
+	}
+
+	buf->enqueue(p);
+	buf->_size = size;
+
+	if (buf->_count == 1) {
+		buf->_deadline = Timestamp::now_steady() + _max_delay;
+		if (!_timer.scheduled() || buf->_deadline < _timer.expiry_steady()) {
+			_timer.schedule_at_steady(buf->_deadline);
+		}
+	}
+
+	// not even an empty MSDU would fit anymore
+	if (((size + 3) & ~3) + AMSDU_SUBFRAME_HEADER_LEN + (int) sizeof(struct click_llc) > _max_size) {
+		flush(buf);
+	}
+
+}
+
+void EmpowerAMSDUAggregator::run_timer(Timer *) {
+
+	Timestamp now = Timestamp::now_steady();
+	Timestamp next;
+
+	for (AMSDUIter it = _buffers.begin(); it.live();) {
+		AMSDUBuffer *buf = &it.value();
+		if (buf->_count) {
+			if (buf->_deadline <= now) {
+				flush(buf);
+			} else if (!next || buf->_deadline < next) {
+				next = buf->_deadline;
+			}
+		}
+		// drop the buffers of stations that are gone
+		if (!buf->_count && !_el->get_ess(it.key())) {
+			it = _buffers.erase(it);
+		} else {
+			it++;
+		}
+	}
+
+	if (next) {
+		_timer.schedule_at_steady(next);
+	}
+
+}
+
+void EmpowerAMSDUAggregator::flush(AMSDUBuffer *buf) {
+
+	if (!buf->_count) {
+		return;
+	}
+
+	Packet *p;
+	int count = buf->_count;
+
+	if (count == 1) {
+		p = buf->_head;
+		p->set_next(0);
+		buf->_passthrough++;
+		_passthrough++;
+	} else {
+		p = build_amsdu(buf);
+		buf->_amsdus++;
+		buf->_aggregated += count;
+		_amsdus++;
+		_aggregated += count;
+	}
+
+	buf->_head = buf->_tail = 0;
+	buf->_count = 0;
+	buf->_size = 0;
+
+	if (!p) {
+		return;
+	}
+
+	if (_debug && count > 1) {
+		click_chatter("%{element} :: %s :: %d frames, %d bytes",
+					  this,
+					  __func__,
+					  count,
+					  p->length());
+	}
+
+	output(0).push(p);
+
+}
+
+// Builds a QoS data frame carrying the frames held in buf as A-MSDU
+// subframes and releases them. The 802.11 header and the annotations
+// are those of the first frame.
+Packet *
+EmpowerAMSDUAggregator::build_amsdu(AMSDUBuffer *buf) {
+
+	Packet *first = buf->_head;
+	int hlen = sizeof(struct click_wifi) + 2;
+
+	WritablePacket *q = Packet::make(hlen + buf->_size);
+
+	if (q) {
+		memset(q->data(), 0, q->length());
+		q->copy_annotations(first);
+		memcpy(q->data(), first->data(), sizeof(struct click_wifi));
+		struct click_wifi *w = (struct click_wifi *) q->data();
+		w->i_fc[0] = (uint8_t) (WIFI_FC0_VERSION_0 | WIFI_FC0_TYPE_DATA | WIFI_FC0_SUBTYPE_QOS);
+		q->data()[sizeof(struct click_wifi)] = QOS_CTRL_AMSDU_PRESENT;
+	} else {
+		click_chatter("%{element} :: %s :: cannot make packet!",
+					  this,
+					  __func__);
+	}
+
+	int offset = 0;
+	Packet *p = first;
+
+	while (p) {
+		Packet *next = p->next();
+		if (q) {
+			offset = (offset + 3) & ~3;
+			struct click_wifi *pw = (struct click_wifi *) p->data();
+			uint16_t len = p->length() - sizeof(struct click_wifi);
+			uint8_t *ptr = q->data() + hlen + offset;
+			memcpy(ptr, pw->i_addr1, 6);
+			memcpy(ptr + 6, pw->i_addr3, 6);
+			ptr[12] = len >> 8;
+			ptr[13] = len & 0xff;
+			memcpy(ptr + AMSDU_SUBFRAME_HEADER_LEN, p->data() + sizeof(struct click_wifi), len);
+			offset += AMSDU_SUBFRAME_HEADER_LEN + len;
+		}
+		p->kill();
+		p = next;
+	}
+
+	assert(!q || offset == buf->_size);
+
+	return q;
+
+}
+
+enum {
+	H_DEBUG,
+	H_STATS,
+	H_STATIONS,
+	H_MAX_SIZE,
+	H_MAX_DELAY
+};
+
+String EmpowerAMSDUAggregator::read_handler(Element *e, void *thunk) {
+	EmpowerAMSDUAggregator *td = (EmpowerAMSDUAggregator *) e;
+	switch ((uintptr_t) thunk) {
+	case H_DEBUG:
+		return String(td->_debug) + "\n";
+	case H_STATS: {
+		StringAccum sa;
+		sa << "msdus " << td->_msdus;
+		sa << " passthrough " << td->_passthrough;
+		sa << " amsdus " << td->_amsdus;
+		sa << " aggregated " << td->_aggregated;
+		sa << " ratio " << (td->_amsdus ? (double) td->_aggregated / td->_amsdus : 0) << "\n";
+		return sa.take_string();
+	}
+	case H_STATIONS: {
+		StringAccum sa;
+		for (AMSDUIter it = td->_buffers.begin(); it.live(); it++) {
+			const AMSDUBuffer &buf = it.value();
+			sa << it.key().unparse();
+			sa << " msdus " << buf._msdus;
+			sa << " passthrough " << buf._passthrough;
+			sa << " amsdus " << buf._amsdus;
+			sa << " aggregated " << buf._aggregated;
+			sa << " ratio " << (buf._amsdus ? (double) buf._aggregated / buf._amsdus : 0);
+			sa << " held " << buf._count << "\n";
+		}
+		return sa.take_string();
+	}
+	case H_MAX_SIZE:
+		return String(td->_max_size) + "\n";
+	case H_MAX_DELAY:
+		return td->_max_delay.unparse_interval() + "\n";
+	default:
+		return String();
+	}
+}
+
+int EmpowerAMSDUAggregator::write_handler(const String &in_s, Element *e, void *vparam, ErrorHandler *errh) {
+	EmpowerAMSDUAggregator *f = (EmpowerAMSDUAggregator *) e;
+	String s = cp_uncomment(in_s);
+	switch ((intptr_t) vparam) {
+	case H_DEBUG: {
+		bool debug;
+		if (!BoolArg().parse(s, debug))
+			return errh->error("debug parameter must be boolean");
+		f->_debug = debug;
+		break;
+	}
+	case H_MAX_SIZE: {
+		int max_size;
+		if (!IntArg().parse(s, max_size) || max_size <= AMSDU_SUBFRAME_HEADER_LEN)
+			return errh->error("max_size parameter must be larger than %d", AMSDU_SUBFRAME_HEADER_LEN);
+		// held aggregates may no longer fit
+		for (AMSDUIter it = f->_buffers.begin(); it.live(); it++) {
+			f->flush(&it.value());
+		}
+		f->_max_size = max_size;
+		break;
+	}
+	case H_MAX_DELAY: {
+		Timestamp max_delay;
+		if (!cp_time(s, &max_delay))
+			return errh->error("max_delay parameter must be a time");
+		f->_max_delay = max_delay;
+		break;
+	}
+	}
+	return 0;
+}
+
+void EmpowerAMSDUAggregator::add_handlers() {
+	add_read_handler("debug", read_handler, (void *) H_DEBUG);
+	add_read_handler("stats", read_handler, (void *) H_STATS);
+	add_read_handler("stations", read_handler, (void *) H_STATIONS);
+	add_read_handler("max_size", read_handler, (void *) H_MAX_SIZE);
+	add_read_handler("max_delay", read_handler, (void *) H_MAX_DELAY);
+	add_write_handler("debug", write_handler, (void *) H_DEBUG);
+	add_write_handler("max_size", write_handler, (void *) H_MAX_SIZE);
+	add_write_handler("max_delay", write_handler, (void *) H_MAX_DELAY);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(EmpowerAMSDUAggregator)
@@ -0,0 +1,149 @@
+// -*- mode: c++; c-basic-offset: 2 -*-
+#ifndef CLICK_EMPOWERAMSDUAGGREGATOR_HH
+#define CLICK_EMPOWERAMSDUAGGREGATOR_HH
+#include <click/config.h>
+#include <click/element.hh>
+#include <click/etheraddress.hh>
+#include <click/hashtable.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+
+/*
+=c
+
+EmpowerAMSDUAggregator(EL[, I<KEYWORDS>])
+
+=s EmPOWER
+
+Packs downlink frames to HT LVAPs into A-MSDUs
+
+=d
+
+Takes the 802.11 data frames produced by EmpowerWifiEncap and, for the
+LVAPs whose transmission policy has HT rates, packs consecutive frames
+destined to the same station into a single QoS data frame carrying an
+A-MSDU. Small frames (TCP ACKs, VoIP) then share the PHY and MAC overhead
+of one transmission. A frame is held until the aggregate reaches MAX_SIZE
+or the first frame of the aggregate has waited MAX_DELAY. A lone frame is
+sent as it is. Group frames and frames to non-HT LVAPs are passed through
+untouched, after any frames held for the same station.
+
+Keyword arguments are:
+
+=over 8
+
+=item EL
+An EmpowerLVAPManager element
+
+=item MAX_SIZE
+Maximum A-MSDU length in bytes, default is 3839 (the smallest maximum
+every HT station must accept)
+
+=item MAX_DELAY
+How long the first frame of an aggregate can be held, default is 1ms
+
+=item DEBUG
+Turn debug on/off
+
+=back 8
+
+=e
+
+  wifi_encap :: EmpowerWifiEncap(EL el)
+    -> EmpowerAMSDUAggregator(EL el, MAX_DELAY 2ms)
+    -> switch_data;
+
+=h stats read-only
+Frames received, frames passed through, A-MSDUs sent, frames aggregated
+and the average number of frames per A-MSDU
+
+=h stations read-only
+Same counters for every HT station with an LVAP
+
+=h max_size read/write
+Maximum A-MSDU length
+
+=h max_delay read/write
+Maximum holding time
+
+=a EmpowerWifiEncap, EmpowerAirtimeQueue
+*/
+
+class AMSDUBuffer {
+public:
+	Packet *_head;
+	Packet *_tail;
+	int _count;
+	int _size; // A-MSDU payload, subframe headers and padding included
+	Timestamp _deadline;
+	uint32_t _msdus;
+	uint32_t _passthrough;
+	uint32_t _amsdus;
+	uint32_t _aggregated;
+
+	AMSDUBuffer() :
+		_head(0), _tail(0), _count(0), _size(0), _msdus(0), _passthrough(0),
+		_amsdus(0), _aggregated(0) {
+	}
+
+	void enqueue(Packet *p) {
+		p->set_next(0);
+		if (_tail) {
+			_tail->set_next(p);
+		} else {
+			_head = p;
+		}
+		_tail = p;
+		_count++;
+	}
+};
+
+typedef HashTable<EtherAddress, AMSDUBuffer> AMSDUBuffers;
+typedef AMSDUBuffers::iterator AMSDUIter;
+
+class EmpowerAMSDUAggregator: public Element {
+public:
+
+	EmpowerAMSDUAggregator();
+	~EmpowerAMSDUAggregator();
+
+	const char *class_name() const { return "EmpowerAMSDUAggregator"; }
+	const char *port_count() const { return PORTS_1_1; }
+	const char *processing() const { return PUSH; }
+
+	int configure(Vector<String> &, ErrorHandler *);
+	int initialize(ErrorHandler *);
+	void cleanup(CleanupStage);
+	void add_handlers();
+
+	void push(int, Packet *);
+	void run_timer(Timer *);
+
+private:
+
+	class EmpowerLVAPManager *_el;
+
+	Timer _timer;
+	AMSDUBuffers _buffers;
+
+	int _max_size;
+	Timestamp _max_delay;
+
+	uint32_t _msdus;
+	uint32_t _passthrough;
+	uint32_t _amsdus;
+	uint32_t _aggregated;
+
+	bool _debug;
+
+	bool aggregable(EtherAddress);
+	void flush(AMSDUBuffer *);
+	Packet *build_amsdu(AMSDUBuffer *);
+
+	static int write_handler(const String &, Element *, void *, ErrorHandler *);
+	static String read_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -413,6 +413,7 @@ void EmpowerAssociationResponder::send_association_response(EtherAddress dst,
     EmpowerStationState *ess = _el->get_ess(dst);
 
 	ess->_association_status = true;
+	_el->index_lvap(ess);
 
 	if (_debug) {
 		click_chatter("%{element} :: %s :: association %s assoc_id %d",
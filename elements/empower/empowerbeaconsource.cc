@@ -29,10 +29,18 @@
 CLICK_DECLS
 
 EmpowerBeaconSource::EmpowerBeaconSource() :
-		_el(0), _period(500), _timer(this), _debug(false) {
+		_el(0), _period(500), _timer(this), _nb_slots(10), _slot(0), _slot_usec(0),
+		_nb_beacons(0), _nb_drops(0), _last_tick_beacons(0), _max_tick_beacons(0),
+		_ticks(0), _template_timeout(10), _template_hits(0), _template_misses(0),
+		_debug(false) {
 }
 
 EmpowerBeaconSource::~EmpowerBeaconSource() {
+	for (BTmplIter it = _templates.begin(); it.live(); it++) {
+		for (int i = 0; i < it.value().size(); i++) {
+			it.value()[i]._p->kill();
+		}
+	}
 }
 
 int EmpowerBeaconSource::configure(Vector<String> &conf, ErrorHandler *errh) {
@@ -40,13 +48,26 @@ int EmpowerBeaconSource::configure(Vector<String> &conf, ErrorHandler *errh) {
 	int ret = Args(conf, this, errh)
               .read_m("EL", ElementCastArg("EmpowerLVAPManager"), _el)
 			  .read("PERIOD", _period)
+			  .read("SLOTS", _nb_slots)
+			  .read("TEMPLATE_TIMEOUT", _template_timeout)
 			  .read("DEBUG", _debug).complete();
 
+	if (ret < 0)
+		return ret;
+
+	if (_template_timeout == 0)
+		return errh->error("TEMPLATE_TIMEOUT must be positive");
+
+	if (_nb_slots <= 0 || (unsigned) _nb_slots > _period)
+		return errh->error("SLOTS must be between 1 and PERIOD");
+
 	return ret;
 
 }
 
 int EmpowerBeaconSource::initialize(ErrorHandler *) {
+	_wheel.resize(_nb_slots);
+	_slot_usec = (_period * 1000) / _nb_slots;
 	_timer.initialize(this);
 	_timer.schedule_now();
 	return 0;
@@ -54,20 +75,102 @@ int EmpowerBeaconSource::initialize(ErrorHandler *) {
 
 void EmpowerBeaconSource::run_timer(Timer *) {
 
-	// send LVAP beacon
+	if (_slot == 0) {
+		assign_slots();
+	}
+
+	uint32_t emitted = _nb_beacons;
+
+	// send the beacons whose tbtt falls in this slot
+	Vector<EtherAddress> *slot = &_wheel[_slot];
+
+	for (int i = 0; i < slot->size();) {
+
+		EtherAddress key = (*slot)[i];
+		BeaconSlot *bs = _slots.get_pointer(key);
+
+		EmpowerStationState *ess = 0;
+		EmpowerVAPState *vap = 0;
+
+		if (bs->_lvap) {
+			ess = _el->lvaps()->get_pointer(key);
+		} else {
+			vap = _el->vaps()->get_pointer(key);
+		}
+
+		// the lvap or vap is gone, free its slot
+		if (!ess && !vap) {
+			_slots.erase(key);
+			(*slot)[i] = slot->back();
+			slot->pop_back();
+			continue;
+		}
+
+		if (ess) {
+			send_lvap_csa_beacon(ess);
+		} else {
+			send_beacon(EtherAddress::make_broadcast(), vap->_net_bssid,
+					vap->_ssid, vap->_channel, vap->_iface_id,
+					false, false, 0, 0, 0);
+		}
+
+		i++;
+
+	}
+
+	_last_tick_beacons = _nb_beacons - emitted;
+	if (_last_tick_beacons > _max_tick_beacons) {
+		_max_tick_beacons = _last_tick_beacons;
+	}
+
+	_slot = (_slot + 1) % _wheel.size();
+
+	if (_slot == 0) {
+		// release the templates of bssids that are gone
+		_ticks++;
+		if (_ticks % _template_timeout == 0) {
+			expire_templates();
+		}
+	}
+
+	// keep the slots phase locked to the first expiry
+	_timer.reschedule_after(Timestamp::make_usec(_slot_usec));
+
+}
+
+void EmpowerBeaconSource::assign_slots() {
+
+	// new lvaps and vaps go to the least loaded slot and keep it
+	// for their whole lifetime
 	for (LVAPIter it = _el->lvaps()->begin(); it.live(); it++) {
-		send_lvap_csa_beacon(&it.value());
+		if (!_slots.get_pointer(it.key())) {
+			add_to_slot(it.key(), true);
+		}
 	}
 
-	// send VAP beacons
 	for (VAPIter it = _el->vaps()->begin(); it.live(); it++) {
-		send_beacon(EtherAddress::make_broadcast(), it.value()._net_bssid,
-				it.value()._ssid, it.value()._channel, it.value()._iface_id,
-				false, false, 0, 0, 0);
+		if (!_slots.get_pointer(it.key())) {
+			add_to_slot(it.key(), false);
+		}
 	}
 
-	// re-schedule the timer with some jitter
-	_timer.schedule_after_msec(_period);
+}
+
+void EmpowerBeaconSource::add_to_slot(EtherAddress key, bool lvap) {
+
+	int slot = 0;
+	for (int i = 1; i < _wheel.size(); i++) {
+		if (_wheel[i].size() < _wheel[slot].size()) {
+			slot = i;
+		}
+	}
+
+	BeaconSlot bs;
+	bs._slot = slot;
+	bs._lvap = lvap;
+
+	_slots.set(key, bs);
+	_wheel[slot].push_back(key);
 
 }
 
@@ -121,10 +224,15 @@ void EmpowerBeaconSource::send_lvap_csa_beacon(EmpowerStationState *ess) {
 					  ess->_sta.unparse().c_str());
 
 		// if target iface is found then this is a band steering operation, update LVAP
+		int old_iface = ess->_iface_id;
 		ess->_hwaddr = ess->_target_hwaddr;
 		ess->_channel = ess->_target_channel;
 		ess->_band = ess->_target_band;
 		ess->_iface_id = target_iface;
+		_el->update_txp(ess);
+		_el->move_lvap_queue(ess, old_iface);
+		_el->index_lvap(ess);
+		_el->mask_lvap(ess);
 
 		// set the CSA values to their default
 		ess->_csa_active = false;
@@ -149,6 +257,127 @@ void EmpowerBeaconSource::send_beacon(EtherAddress dst, EtherAddress bssid,
 		String ssid, int channel, int iface_id, bool probe, bool csa_active,
 		int csa_mode, int csa_count, int csa_channel) {
 
+	WritablePacket *p;
+
+	if (csa_active) {
+		// the csa count changes at every beacon, do not cache
+		p = make_beacon(dst, bssid, ssid, channel, iface_id, probe, true,
+				csa_mode, csa_count, csa_channel);
+	} else {
+		BeaconTemplate *tmpl = get_template(bssid, ssid, channel, iface_id, probe);
+		if (!tmpl) {
+			return;
+		}
+		Packet *q = tmpl->_p->clone();
+		p = q ? q->uniqueify() : 0;
+		if (p) {
+			struct click_wifi *w = (struct click_wifi *) p->data();
+			memcpy(w->i_addr1, dst.data(), 6);
+		}
+	}
+
+	if (!p) {
+		click_chatter("%{element} :: %s :: cannot make packet!",
+				      this,
+				      __func__);
+		if (!probe) {
+			_nb_drops++;
+		}
+		return;
+	}
+
+	if (!probe) {
+		_nb_beacons++;
+	}
+
+	SET_PAINT_ANNO(p, iface_id);
+	output(0).push(p);
+
+}
+
+BeaconTemplate *EmpowerBeaconSource::get_template(EtherAddress bssid,
+		String ssid, int channel, int iface_id, bool probe) {
+
+	// only the policy of this bssid goes into the frame
+	TxPolicyInfo *tx_policy = _el->get_tx_policies(iface_id)->lookup(bssid);
+
+	BeaconTemplatesList *templates = _templates.get_pointer(bssid);
+
+	if (!templates) {
+		_templates.set(bssid, BeaconTemplatesList());
+		templates = _templates.get_pointer(bssid);
+	}
+
+	BeaconTemplate *tmpl = 0;
+
+	for (int i = 0; i < templates->size(); i++) {
+		if ((*templates)[i]._probe == probe && (*templates)[i]._iface_id == iface_id
+				&& (*templates)[i]._ssid == ssid) {
+			tmpl = &(*templates)[i];
+			break;
+		}
+	}
+
+	if (tmpl && tmpl->_channel == channel
+			&& tmpl->_tx_policy == tx_policy
+			&& tmpl->_generation == tx_policy->_generation) {
+		tmpl->_last_used = _ticks;
+		_template_hits++;
+		return tmpl;
+	}
+
+	_template_misses++;
+
+	WritablePacket *p = make_beacon(EtherAddress::make_broadcast(), bssid,
+			ssid, channel, iface_id, probe, false, 0, 0, 0);
+
+	if (!p) {
+		return 0;
+	}
+
+	if (!tmpl) {
+		templates->push_back(BeaconTemplate());
+		tmpl = &templates->back();
+		tmpl->_ssid = ssid;
+		tmpl->_probe = probe;
+		tmpl->_iface_id = iface_id;
+	} else {
+		tmpl->_p->kill();
+	}
+
+	tmpl->_channel = channel;
+	tmpl->_tx_policy = tx_policy;
+	tmpl->_generation = tx_policy->_generation;
+	tmpl->_last_used = _ticks;
+	tmpl->_p = p;
+
+	return tmpl;
+
+}
+
+void EmpowerBeaconSource::expire_templates() {
+	for (BTmplIter it = _templates.begin(); it.live();) {
+		BeaconTemplatesList *templates = &it.value();
+		for (int i = 0; i < templates->size();) {
+			if (_ticks - (*templates)[i]._last_used >= _template_timeout) {
+				(*templates)[i]._p->kill();
+				templates->erase(templates->begin() + i);
+			} else {
+				i++;
+			}
+		}
+		if (templates->empty()) {
+			it = _templates.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+WritablePacket *EmpowerBeaconSource::make_beacon(EtherAddress dst, EtherAddress bssid,
+		String ssid, int channel, int iface_id, bool probe, bool csa_active,
+		int csa_mode, int csa_count, int csa_channel) {
+
 	/* order elements by standard
 	 * needed by sloppy 802.11b driver implementations
 	 * to be able to connect to 802.11g APs
@@ -174,15 +403,13 @@ void EmpowerBeaconSource::send_beacon(EtherAddress dst, EtherAddress bssid,
 	}
 
 	WritablePacket *p = Packet::make(max_len);
-	memset(p->data(), 0, p->length());
 
 	if (!p) {
-		click_chatter("%{element} :: %s :: cannot make packet!",
-				      this,
-				      __func__);
-		return;
+		return 0;
 	}
 
+	memset(p->data(), 0, p->length());
+
 	struct click_wifi *w = (struct click_wifi *) p->data();
 
 	w->i_fc[0] = WIFI_FC0_VERSION_0 | WIFI_FC0_TYPE_MGT;
@@ -378,8 +605,8 @@ void EmpowerBeaconSource::send_beacon(EtherAddress dst, EtherAddress bssid,
 	}
 
 	p->take(max_len - actual_length);
-	SET_PAINT_ANNO(p, iface_id);
-	output(0).push(p);
+
+	return p;
 
 }
 
@@ -418,6 +645,16 @@ void EmpowerBeaconSource::push(int, Packet *p) {
 		return;
 	}
 
+	EtherAddress src = EtherAddress(w->i_addr2);
+
+	EmpowerStationState *ess = _el->get_ess(src);
+
+	// if this is an uplink only lvap then ignore request
+	if (ess && !ess->_set_mask) {
+		p->kill();
+		return;
+	}
+
 	uint8_t *ptr = (uint8_t *) p->data() + sizeof(struct click_wifi);
 	uint8_t *end = (uint8_t *) p->data() + p->length();
 
@@ -426,7 +663,7 @@ void EmpowerBeaconSource::push(int, Packet *p) {
 	uint8_t *rates_x = NULL;
 	uint8_t *htcaps = NULL;
 
-	while (ptr < end) {
+	while (ptr + 2 <= end && ptr + 2 + ptr[1] <= end) {
 		switch (*ptr) {
 		case WIFI_ELEMID_SSID:
 			ssid_l = ptr;
@@ -449,17 +686,69 @@ void EmpowerBeaconSource::push(int, Packet *p) {
 						      ptr[1]);
 			}
 		}
+		// known stations are answered from the ssid alone, which is
+		// the first element of a probe request
+		if (ess && ssid_l && !_debug) {
+			break;
+		}
 		ptr += ptr[1] + 2;
 	}
 
-	EtherAddress src = EtherAddress(w->i_addr2);
 	String ssid = "";
 
     if (ssid_l && ssid_l[1]) {
 		ssid = String((char *) ssid_l + 2, WIFI_MIN((int)ssid_l[1], WIFI_NWID_MAXSIZE));
 	}
 
-    StringAccum sa;
+	/* print rates information */
+	if (_debug) {
+		click_chatter("%{element} :: %s :: %s",
+				      this,
+				      __func__,
+				      unparse_probe_request(src, ssid, rates_l, rates_x, htcaps).c_str());
+	}
+
+	/* If we're not aware of this LVAP, then send to the controller.
+	 * The controller may also decide not to reply for example if the
+	 * STA is already handled by another LVAP (which is in charge for
+	 * generating the probe response).
+	 */
+
+	if (!ess) {
+		if (_debug) {
+			click_chatter("%{element} :: %s :: sending probe request to ctrl %s",
+					      this,
+					      __func__,
+					      src.unparse().c_str());
+		}
+		ResourceElement *el = _el->iface_to_element(iface_id);
+		if (htcaps && (el->_band == EMPOWER_BT_HT20)) {
+			_el->send_probe_request(src, ssid, el->_hwaddr, el->_channel, el->_band, EMPOWER_BT_HT20);
+		} else {
+			_el->send_probe_request(src, ssid, el->_hwaddr, el->_channel, el->_band, EMPOWER_BT_L20);
+		}
+		p->kill();
+		return;
+	}
+
+	/* If the client is performing an active scan, then
+     * then respond from all available SSIDs. Else, if
+     * the client is probing for a particular SSID, check
+     * if we're indeed hosting that SSID and respond
+     * accordingly.
+     */
+
+	send_probe_response(ess, ssid);
+
+	/* probe processed */
+	p->kill();
+
+}
+
+String EmpowerBeaconSource::unparse_probe_request(EtherAddress src, String ssid,
+		uint8_t *rates_l, uint8_t *rates_x, uint8_t *htcaps) {
+
+	StringAccum sa;
 	Vector<int> rates;
 	Vector<int> ht_rates;
 
@@ -636,56 +925,7 @@ void EmpowerBeaconSource::push(int, Packet *p) {
 		sa << " ]";
 	}
 
-	/* print rates information */
-	if (_debug) {
-		click_chatter("%{element} :: %s :: %s",
-				      this,
-				      __func__,
-				      sa.take_string().c_str());
-	}
-
-	/* If we're not aware of this LVAP, then send to the controller.
-	 * The controller may also decide not to reply for example if the
-	 * STA is already handled by another LVAP (which is in charge for
-	 * generating the probe response).
-	 */
-
-	EmpowerStationState *ess = _el->get_ess(src);
-
-	if (!ess) {
-		if (_debug) {
-			click_chatter("%{element} :: %s :: sending probe request to ctrl %s",
-					      this,
-					      __func__,
-					      src.unparse().c_str());
-		}
-		ResourceElement *el = _el->iface_to_element(iface_id);
-		if (htcaps && (el->_band == EMPOWER_BT_HT20)) {
-			_el->send_probe_request(src, ssid, el->_hwaddr, el->_channel, el->_band, EMPOWER_BT_HT20);
-		} else {
-			_el->send_probe_request(src, ssid, el->_hwaddr, el->_channel, el->_band, EMPOWER_BT_L20);
-		}
-		p->kill();
-		return;
-	}
-
-	// if this is an uplink only lvap then ignore request
-	if (!ess->_set_mask) {
-		p->kill();
-		return;
-	}
-
-	/* If the client is performing an active scan, then
-     * then respond from all available SSIDs. Else, if
-     * the client is probing for a particular SSID, check
-     * if we're indeed hosting that SSID and respond
-     * accordingly.
-     */
-
-	send_probe_response(ess, ssid);
-
-	/* probe processed */
-	p->kill();
+	return sa.take_string();
 
 }
 
@@ -732,11 +972,47 @@ void EmpowerBeaconSource::send_probe_response(EmpowerStationState *ess, String s
 
 enum {
 	H_DEBUG,
+	H_TEMPLATES,
+	H_SLOTS,
+	H_STATS,
 };
 
 String EmpowerBeaconSource::read_handler(Element *e, void *thunk) {
 	EmpowerBeaconSource *td = (EmpowerBeaconSource *) e;
 	switch ((uintptr_t) thunk) {
+	case H_SLOTS: {
+		StringAccum sa;
+		for (int i = 0; i < td->_wheel.size(); i++) {
+			sa << "slot " << i << " offset " << (i * td->_slot_usec) << "us";
+			sa << " beacons " << td->_wheel[i].size() << "\n";
+		}
+		return sa.take_string();
+	}
+	case H_STATS: {
+		StringAccum sa;
+		sa << "beacons " << td->_nb_beacons;
+		sa << " drops " << td->_nb_drops;
+		sa << " last_tick " << td->_last_tick_beacons;
+		sa << " max_tick " << td->_max_tick_beacons << "\n";
+		return sa.take_string();
+	}
+	case H_TEMPLATES: {
+		StringAccum sa;
+		sa << "hits " << td->_template_hits << " misses " << td->_template_misses << "\n";
+		for (BTmplIter it = td->_templates.begin(); it.live(); it++) {
+			for (int i = 0; i < it.value().size(); i++) {
+				BeaconTemplate *tmpl = &it.value()[i];
+				sa << it.key().unparse();
+				sa << " ssid " << tmpl->_ssid;
+				sa << (tmpl->_probe ? " probe" : " beacon");
+				sa << " channel " << tmpl->_channel;
+				sa << " iface_id " << tmpl->_iface_id;
+				sa << " length " << tmpl->_p->length();
+				sa << "\n";
+			}
+		}
+		return sa.take_string();
+	}
 	case H_DEBUG:
 		return String(td->_debug) + "\n";
 	default:
@@ -763,6 +1039,9 @@ int EmpowerBeaconSource::write_handler(const String &in_s, Element *e,
 }
 
 void EmpowerBeaconSource::add_handlers() {
+	add_read_handler("templates", read_handler, (void *) H_TEMPLATES);
+	add_read_handler("slots", read_handler, (void *) H_SLOTS);
+	add_read_handler("stats", read_handler, (void *) H_STATS);
 	add_read_handler("debug", read_handler, (void *) H_DEBUG);
 	add_write_handler("debug", write_handler, (void *) H_DEBUG);
 }
@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/config.h>
 #include <click/timer.hh>
+#include <click/hashtable.hh>
 #include <elements/wifi/availablerates.hh>
 #include "empowerlvapmanager.hh"
 CLICK_DECLS
@@ -24,6 +25,24 @@ Point (WTP). Subsequent probe request are directly handled by the WTP.
 
 =d
 
+The beacon interval is split in SLOTS slots. Every LVAP and VAP is
+assigned to the least loaded slot when it first shows up and keeps it
+for its whole lifetime, so beacons are spread evenly over the interval
+instead of being sent in one burst, and the target beacon transmission
+time of a BSSID does not move when other LVAPs come and go.
+
+Beacons and probe responses are built once per interface, BSSID and
+SSID and kept as templates. Each transmission clones the template and
+patches the destination address. A template is rebuilt when the channel
+or the transmission policy of its BSSID change, other stations' policies
+do not matter. Beacons carrying a channel switch announcement are always
+built from scratch.
+Templates unused for TEMPLATE_TIMEOUT periods are released.
+
+Probe requests from known stations are answered after reading only the
+SSID element. The other elements are parsed only for unknown stations,
+which are reported to the Access Controller, or when debugging.
+
 Keyword arguments are:
 
 =over 8
@@ -40,14 +59,67 @@ The wireless channel it is operating on.
 =item PERIOD
 How often beacon packets are sent, in milliseconds.
 
+=item SLOTS
+Number of slots the beacon interval is divided in. Default is 10.
+
+=item TEMPLATE_TIMEOUT
+Number of periods after which an unused template is released. Default
+is 10.
+
 =item DEBUG
 Turn debug on/off
 
 =back 8
 
+=h slots read-only
+Number of beacons sent in each slot.
+
+=h stats read-only
+Beacons sent, beacons that could not be built, beacons sent in the last
+slot and the largest number of beacons sent in a single slot.
+
+=h templates read-only
+Cached templates, with hit and miss counters.
+
 =a EmpowerLVAPManager
 */
 
+class BeaconTemplate {
+public:
+
+	String _ssid;
+	bool _probe;
+	int _channel;
+	int _iface_id;
+	TxPolicyInfo *_tx_policy;
+	uint32_t _generation;
+	unsigned _last_used;
+	Packet *_p;
+
+	BeaconTemplate() :
+			_probe(false), _channel(0), _iface_id(-1), _tx_policy(0),
+			_generation(0), _last_used(0), _p(0) {
+	}
+
+};
+
+class BeaconSlot {
+public:
+
+	int _slot;
+	bool _lvap;
+
+	BeaconSlot() : _slot(0), _lvap(false) {
+	}
+
+};
+
+typedef HashTable<EtherAddress, BeaconSlot> BeaconSlots;
+
+typedef Vector<BeaconTemplate> BeaconTemplatesList;
+typedef HashTable<EtherAddress, BeaconTemplatesList> BeaconTemplates;
+typedef BeaconTemplates::iterator BTmplIter;
+
 class EmpowerBeaconSource: public Element {
 public:
 
@@ -77,8 +149,35 @@ private:
 	unsigned int _period; // msecs
 	Timer _timer;
 
+	// beacon wheel, lvaps are keyed by sta and vaps by bssid
+	BeaconSlots _slots;
+	Vector<Vector<EtherAddress> > _wheel;
+	int _nb_slots;
+	int _slot;
+	uint32_t _slot_usec;
+
+	uint32_t _nb_beacons;
+	uint32_t _nb_drops;
+	uint32_t _last_tick_beacons;
+	uint32_t _max_tick_beacons;
+
+	BeaconTemplates _templates;
+	unsigned _ticks;
+	unsigned _template_timeout; // in periods
+	uint32_t _template_hits;
+	uint32_t _template_misses;
+
 	bool _debug;
 
+	WritablePacket *make_beacon(EtherAddress, EtherAddress, String, int, int, bool, bool, int, int, int);
+	BeaconTemplate *get_template(EtherAddress, String, int, int, bool);
+	void expire_templates();
+
+	String unparse_probe_request(EtherAddress, String, uint8_t *, uint8_t *, uint8_t *);
+
+	void assign_slots();
+	void add_to_slot(EtherAddress, bool);
+
 	// Read/Write handlers
 	static String read_handler(Element *e, void *user_data);
 	static int write_handler(const String &, Element *, void *, ErrorHandler *);
@@ -40,6 +40,7 @@ EmpowerCQM::~EmpowerCQM() {
 }
 
 int EmpowerCQM::initialize(ErrorHandler *) {
+	_busy_time.resize(_el->num_ifaces(), 0);
 	_timer.initialize(this);
 	_timer.schedule_now();
 	return 0;
@@ -58,12 +59,39 @@ int EmpowerCQM::configure(Vector<String> &conf, ErrorHandler *errh) {
 
 }
 
+void EmpowerCQM::take_state(Element *e, ErrorHandler *) {
+
+	EmpowerCQM *q = (EmpowerCQM *) e->cast("EmpowerCQM");
+
+	if (!q) {
+		return;
+	}
+
+	links.swap(q->links);
+
+	for (CLTIter iter = links.begin(); iter.live(); iter++) {
+		iter.value().cqm = this;
+	}
+
+	// busy time is indexed by interface
+	if (_busy_time.size() == q->_busy_time.size()) {
+		_busy_time.swap(q->_busy_time);
+	}
+
+}
+
 void EmpowerCQM::run_timer(Timer *) {
 	lock.acquire_write();
 	// process links
 	for (CLTIter iter = links.begin(); iter.live();) {
-		// Update estimator
 		CqmLink *nfo = &iter.value();
+		// Busy time caused by the other transmitters on the interface
+		if (nfo->iface_id >= 0 && nfo->iface_id < _busy_time.size()) {
+			double others = _busy_time[nfo->iface_id] - nfo->own_busy_time;
+			nfo->add_cbt_sample(others > 0 ? others : 0);
+		}
+		nfo->own_busy_time = 0;
+		// Update estimator
 		nfo->estimator(_period, _debug);
 		// Delete stale entries
 		if (nfo->silentWindowCount> _max_silent_window_count) {
@@ -72,6 +100,9 @@ void EmpowerCQM::run_timer(Timer *) {
 			++iter;
 		}
 	}
+	for (int i = 0; i < _busy_time.size(); i++) {
+		_busy_time[i] = 0;
+	}
 	lock.release_write();
 	// rescheduler
 	_timer.schedule_after_msec(_period);
@@ -116,11 +147,15 @@ EmpowerCQM::simple_action(Packet *p) {
 
 	lock.acquire_write();
 
+	CqmLink *nfo;
+
 	if (retry != 1) {
-		update_link_table(ta, iface_id, w->i_seq, p->length(), rssi);
+		nfo = update_link_table(ta, iface_id, w->i_seq, p->length(), rssi);
+	} else {
+		nfo = links.get_pointer(ta);
 	}
 
-	update_channel_busy_time(iface_id, ta, p->length(), ceh->rate);
+	update_channel_busy_time(iface_id, nfo, p->length(), ceh->rate);
 
 	lock.release_write();
 
@@ -128,19 +163,18 @@ EmpowerCQM::simple_action(Packet *p) {
 
 }
 
-void EmpowerCQM::update_channel_busy_time(uint8_t iface_id, EtherAddress ta, uint32_t len, uint8_t rate) {
-	for (CLTIter iter = links.begin(); iter.live(); iter++) {
-		CqmLink *nfo = &iter.value();
-		if (nfo && nfo->iface_id == iface_id) {
-			if(ta != nfo->sourceAddr) {
-				unsigned usec = calc_usecs_wifi_packet(len, rate, 0);
-				nfo->add_cbt_sample(usec);
-			}
-		}
+void EmpowerCQM::update_channel_busy_time(uint8_t iface_id, CqmLink *nfo, uint32_t len, uint8_t rate) {
+	unsigned usec = calc_usecs_wifi_packet(len, rate, 0);
+	if (iface_id >= _busy_time.size()) {
+		_busy_time.resize(iface_id + 1, 0);
+	}
+	_busy_time[iface_id] += usec;
+	if (nfo && nfo->iface_id == iface_id) {
+		nfo->add_own_cbt_sample(usec);
 	}
 }
 
-void EmpowerCQM::update_link_table(EtherAddress ta, uint8_t iface_id, uint16_t seq, uint32_t len, uint8_t rssi) {
+CqmLink *EmpowerCQM::update_link_table(EtherAddress ta, uint8_t iface_id, uint16_t seq, uint32_t len, uint8_t rssi) {
 
 	// Update channel quality map
 	CqmLink *nfo;
@@ -163,6 +197,8 @@ void EmpowerCQM::update_link_table(EtherAddress ta, uint8_t iface_id, uint16_t s
 	// Add sample
 	nfo->add_sample(len, rssi, seq);
 
+	return nfo;
+
 }
 
 enum {
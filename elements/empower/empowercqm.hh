@@ -24,6 +24,11 @@ CLICK_DECLS
 
  =d
 
+ The airtime of every received frame is added to a per-interface
+ accumulator. At the end of each PERIOD the channel busy time of a link
+ is the interface total minus the airtime of the link's own frames, so
+ the per-frame cost does not depend on the number of neighbours.
+
  Keyword arguments are:
 
  =over 8
@@ -56,6 +61,7 @@ public:
 
 	int initialize(ErrorHandler *);
 	int configure(Vector<String> &, ErrorHandler *);
+	void take_state(Element *, ErrorHandler *);
 	void run_timer(Timer *);
 
 	Packet *simple_action(Packet *);
@@ -70,6 +76,8 @@ private:
 	EmpowerLVAPManager *_el;
 	Timer _timer;
 
+	Vector<uint32_t> _busy_time; // per interface, in usec, current period
+
 	unsigned _period; // in ms
 	unsigned _samples; // in #
 	unsigned _max_silent_window_count; // in number of windows
@@ -80,8 +88,8 @@ private:
 	static int write_handler(const String &, Element *, void *, ErrorHandler *);
 	static String read_handler(Element *, void *);
 
-	void update_link_table(EtherAddress, uint8_t, uint16_t, uint32_t, uint8_t);
-	void update_channel_busy_time(uint8_t, EtherAddress, uint32_t, uint8_t);
+	CqmLink *update_link_table(EtherAddress, uint8_t, uint16_t, uint32_t, uint8_t);
+	void update_channel_busy_time(uint8_t, CqmLink *, uint32_t, uint8_t);
 
 };
 
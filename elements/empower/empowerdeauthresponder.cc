@@ -157,6 +157,7 @@ void EmpowerDeAuthResponder::push(int, Packet *p) {
 	ess->_assoc_id = 0;
 	ess->_ssid = (const char*)'\0';
 	ess->_lvap_bssid = ess->_net_bssid;
+	_el->index_lvap(ess);
 
 	_el->send_status_lvap(src);
 
@@ -143,6 +143,7 @@ void EmpowerDisassocResponder::push(int, Packet *p) {
 	ess->_association_status = false;
 	ess->_assoc_id = 0;
 	ess->_ssid = (const char*)'\0';
+	_el->index_lvap(ess);
 
 	_el->send_status_lvap(src);
 
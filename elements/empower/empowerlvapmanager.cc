@@ -16,6 +16,8 @@
 
 #include <click/config.h>
 #include "empowerlvapmanager.hh"
+#include <fcntl.h>
+#include <unistd.h>
 #include <click/straccum.hh>
 #include <click/args.hh>
 #include <click/error.hh>
@@ -34,25 +36,142 @@
 #include "empowerdisassocresponder.hh"
 #include "empowerrxstats.hh"
 #include "empowercqm.hh"
+#include "empowerairtimequeue.hh"
 CLICK_DECLS
 
+#define EMPOWER_MESSAGE(type, version, st, handler) \
+	{ type, version, sizeof(struct st), &EmpowerLVAPManager::handler, #type }
+
+const EmpowerLVAPManager::MessageType EmpowerLVAPManager::_message_types[] = {
+	EMPOWER_MESSAGE(EMPOWER_PT_HELLO, _empower_version, empower_header, handle_empower_hello),
+	EMPOWER_MESSAGE(EMPOWER_PT_PROBE_RESPONSE, _empower_version, empower_probe_response, handle_probe_response),
+	EMPOWER_MESSAGE(EMPOWER_PT_AUTH_RESPONSE, _empower_version, empower_auth_response, handle_auth_response),
+	EMPOWER_MESSAGE(EMPOWER_PT_ASSOC_RESPONSE, _empower_version, empower_assoc_response, handle_assoc_response),
+	EMPOWER_MESSAGE(EMPOWER_PT_ADD_LVAP, _empower_version, empower_add_lvap, handle_add_lvap),
+	EMPOWER_MESSAGE(EMPOWER_PT_DEL_LVAP, _empower_version, empower_del_lvap, handle_del_lvap),
+	EMPOWER_MESSAGE(EMPOWER_PT_SET_PORT, _empower_version, empower_set_port, handle_set_port),
+	EMPOWER_MESSAGE(EMPOWER_PT_CAPS_REQUEST, _empower_version, empower_header, handle_caps_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_COUNTERS_REQUEST, _empower_version, empower_counters_request, handle_counters_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_ADD_RSSI_TRIGGER, _empower_version, empower_add_rssi_trigger, handle_add_rssi_trigger),
+	EMPOWER_MESSAGE(EMPOWER_PT_DEL_RSSI_TRIGGER, _empower_version, empower_del_rssi_trigger, handle_del_rssi_trigger),
+	EMPOWER_MESSAGE(EMPOWER_PT_ADD_SUMMARY_TRIGGER, _empower_version, empower_add_summary_trigger, handle_add_summary_trigger),
+	EMPOWER_MESSAGE(EMPOWER_PT_DEL_SUMMARY_TRIGGER, _empower_version, empower_del_summary_trigger, handle_del_summary_trigger),
+	EMPOWER_MESSAGE(EMPOWER_PT_UCQM_REQUEST, _empower_version, empower_cqm_request, handle_uimg_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_NCQM_REQUEST, _empower_version, empower_cqm_request, handle_nimg_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_LVAP_STATS_REQUEST, _empower_version, empower_lvap_stats_request, handle_lvap_stats_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_ADD_VAP, _empower_version, empower_add_vap, handle_add_vap),
+	EMPOWER_MESSAGE(EMPOWER_PT_DEL_VAP, _empower_version, empower_del_vap, handle_del_vap),
+	EMPOWER_MESSAGE(EMPOWER_PT_TXP_COUNTERS_REQUEST, _empower_version, empower_txp_counters_request, handle_txp_counters_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_BUSYNESS_REQUEST, _empower_version, empower_busyness_request, handle_busyness_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_ADD_BUSYNESS_TRIGGER, _empower_version, empower_add_busyness_trigger, handle_add_busyness_trigger),
+	EMPOWER_MESSAGE(EMPOWER_PT_DEL_BUSYNESS_TRIGGER, _empower_version, empower_del_busyness_trigger, handle_del_busyness_trigger),
+	EMPOWER_MESSAGE(EMPOWER_PT_WTP_COUNTERS_REQUEST, _empower_version, empower_wtp_counters_request, handle_wtp_counters_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_CQM_LINKS_REQUEST, _empower_version, empower_cqm_links_request, handle_cqm_links_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_INCOM_MCAST_RESPONSE, _empower_version, empower_incom_mcast_addr_response, handle_incom_mcast_addr_response),
+	EMPOWER_MESSAGE(EMPOWER_PT_LVAP_STATUS_REQ, _empower_version, empower_header, handle_lvap_status_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_VAP_STATUS_REQ, _empower_version, empower_header, handle_vap_status_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_PORT_STATUS_REQ, _empower_version, empower_header, handle_port_status_request),
+	EMPOWER_MESSAGE(EMPOWER_PT_SET_AIRTIME_QUANTUM, _empower_version, empower_set_airtime_quantum, handle_set_airtime_quantum),
+	EMPOWER_MESSAGE(EMPOWER_PT_LVAP_AQM_STATS_REQUEST, _empower_version, empower_lvap_aqm_stats_request, handle_lvap_aqm_stats_request),
+};
+
+const int EmpowerLVAPManager::_nb_message_types =
+	sizeof(EmpowerLVAPManager::_message_types) / sizeof(EmpowerLVAPManager::MessageType);
+
+#undef EMPOWER_MESSAGE
+
 EmpowerLVAPManager::EmpowerLVAPManager() :
+		_nb_unknown_messages(0), _nb_invalid_messages(0),
 		_e11k(0), _ebs(0), _eauthr(0), _eassor(0), _edeauthr(0), _ers(0),
-		_cqm(0), _mtbl(0), _timer(this), _seq(0), _period(5000), _debug(false),
-		_hello_seq_ctr(0) {
+		_cqm(0), _mtbl(0), _timer(this), _mask_timer(this), _mask_delay(10),
+		_seq(0), _period(5000), _debug(false),
+		_counters_reset(false), _summary_max_len(65536), _hello_seq_ctr(0) {
+	memset(_dispatch, 0, sizeof(_dispatch));
+	for (int i = 0; i < _nb_message_types; i++) {
+		_dispatch[_message_types[i]._type] = &_message_types[i];
+	}
 }
 
 EmpowerLVAPManager::~EmpowerLVAPManager() {
+	for (int i = 0; i < _masks.size(); i++) {
+		if (_masks[i]._fd >= 0) {
+			close(_masks[i]._fd);
+		}
+	}
 }
 
 int EmpowerLVAPManager::initialize(ErrorHandler *) {
 	_timer.initialize(this);
 	_timer.schedule_now();
-	compute_bssid_mask();
+	_mask_timer.initialize(this);
+	for (int i = 0; i < _masks.size(); i++) {
+		ResourceElement *elm = iface_to_element(i);
+		if (elm) {
+			_masks[i]._hwaddr = elm->_hwaddr;
+		}
+	}
+	// when hot-swapping the masks are written once the LVAPs are taken
+	if (!hotswap_element()) {
+		write_bssid_masks();
+	}
 	return 0;
 }
 
-void EmpowerLVAPManager::run_timer(Timer *) {
+void EmpowerLVAPManager::take_state(Element *e, ErrorHandler *errh) {
+
+	EmpowerLVAPManager *q = (EmpowerLVAPManager *) e->cast("EmpowerLVAPManager");
+
+	if (!q) {
+		write_bssid_masks();
+		return;
+	}
+
+	// LVAPs, VAPs and indexes refer to interfaces by id
+	if (q->_ifaces_to_elements.size() != _ifaces_to_elements.size()) {
+		errh->error("resource elements changed, not taking state");
+		write_bssid_masks();
+		return;
+	}
+
+	for (int i = 0; i < _ifaces_to_elements.size(); i++) {
+		if (!(q->_ifaces_to_elements[i] == _ifaces_to_elements[i])) {
+			errh->error("resource elements changed, not taking state");
+			write_bssid_masks();
+			return;
+		}
+	}
+
+	_lvaps.swap(q->_lvaps);
+	_vaps.swap(q->_vaps);
+	_ports.swap(q->_ports);
+	_iface_index.swap(q->_iface_index);
+
+	for (int i = 0; i < _masks.size() && i < q->_masks.size(); i++) {
+		memcpy(_masks[i]._refs, q->_masks[i]._refs, sizeof(_masks[i]._refs));
+		_masks[i]._mask = q->_masks[i]._mask;
+	}
+
+	_seq = q->_seq;
+
+	for (LVAPIter it = _lvaps.begin(); it.live(); it++) {
+		EmpowerStationState *ess = &it.value();
+		// policies of the old configuration may be gone
+		update_txp(ess);
+		if (_aqs.size()) {
+			_aqs[ess->_iface_id]->add_station(ess->_sta, ess->_airtime_quantum);
+		}
+	}
+
+	write_bssid_masks();
+
+}
+
+void EmpowerLVAPManager::run_timer(Timer *t) {
+	if (t == &_mask_timer) {
+		write_bssid_masks();
+		return;
+	}
+
 	// send hello packet and increase hello counter if connected
 	send_hello();
 	
@@ -126,6 +245,7 @@ int EmpowerLVAPManager::configure(Vector<String> &conf,
 	String debugfs_strings;
 	String rcs_strings;
 	String res_strings;
+	String aqs_strings;
 
 	res = Args(conf, this, errh).read_m("WTP", _wtp)
 						        .read_m("E11K", ElementCastArg("Empower11k"), _e11k)
@@ -135,18 +255,26 @@ int EmpowerLVAPManager::configure(Vector<String> &conf,
 								.read_m("EDEAUTHR", ElementCastArg("EmpowerDeAuthResponder"), _edeauthr)
 			                    .read_m("DEBUGFS", debugfs_strings)
 			                    .read_m("RCS", rcs_strings)
+			                    .read("AQS", aqs_strings)
 			                    .read_m("RES", res_strings)
 			                    .read_m("ERS", ElementCastArg("EmpowerRXStats"), _ers)
 			                    .read("CQM", ElementCastArg("EmpowerCQM"), _cqm)
 								.read("MTBL", ElementCastArg("EmpowerMulticastTable"), _mtbl)
 								.read("PERIOD", _period)
+								.read("COUNTERS_RESET", _counters_reset)
+								.read("SUMMARY_MAX_LEN", _summary_max_len)
+								.read("MASK_DELAY", _mask_delay)
 			                    .read("DEBUG", _debug)
 			                    .complete();
 
+	if (_summary_max_len < sizeof(empower_summary_trigger) + sizeof(summary_entry)) {
+		return errh->error("SUMMARY_MAX_LEN must fit at least one summary entry");
+	}
+
 	cp_spacevec(debugfs_strings, _debugfs_strings);
 
 	for (int i = 0; i < _debugfs_strings.size(); i++) {
-		_masks.push_back(EtherAddress::make_broadcast());
+		_masks.push_back(EmpowerBSSIDMask());
 	}
 
 	Vector<String> tokens;
@@ -164,6 +292,23 @@ int EmpowerLVAPManager::configure(Vector<String> &conf,
 		return errh->error("rcs has %u values, while masks has %u values", _rcs.size(), _masks.size());
 	}
 
+	_iface_index.resize(_rcs.size());
+
+	tokens.clear();
+	cp_spacevec(aqs_strings, tokens);
+
+	for (int i = 0; i < tokens.size(); i++) {
+		EmpowerAirtimeQueue * aq;
+		if (!ElementCastArg("EmpowerAirtimeQueue").parse(tokens[i], aq, Args(conf, this, errh))) {
+			return errh->error("error param %s: must be an EmpowerAirtimeQueue element", tokens[i].c_str());
+		}
+		_aqs.push_back(aq);
+	}
+
+	if (_aqs.size() && _aqs.size() != _rcs.size()) {
+		return errh->error("aqs has %u values, while rcs has %u values", _aqs.size(), _rcs.size());
+	}
+
 	tokens.clear();
 	cp_spacevec(res_strings, tokens);
 
@@ -192,8 +337,9 @@ int EmpowerLVAPManager::configure(Vector<String> &conf,
 			band = EMPOWER_BT_HT20;
 		}
 
-		ResourceElement *elm = new ResourceElement(hwaddr, channel, band);
-		_ifaces_to_elements.set(x, elm);
+		if (set_iface_element(x, ResourceElement(hwaddr, channel, band)) < 0) {
+			return errh->error("error param %s: duplicate resource element", tokens[x].c_str());
+		}
 
 	}
 
@@ -201,6 +347,35 @@ int EmpowerLVAPManager::configure(Vector<String> &conf,
 
 }
 
+/*
+ * Binds a resource element to an interface, keeping the reverse
+ * index in sync. Must be used whenever the channel or the band of
+ * an interface changes.
+ */
+int EmpowerLVAPManager::set_iface_element(int iface, const ResourceElement &elm) {
+
+	const int *other = _elements_to_ifaces.get_pointer(elm);
+
+	if (other && *other != iface) {
+		return -1;
+	}
+
+	if (iface >= _ifaces_to_elements.size()) {
+		_ifaces_to_elements.resize(iface + 1);
+	} else {
+		const int *prev = _elements_to_ifaces.get_pointer(_ifaces_to_elements[iface]);
+		if (prev && *prev == iface) {
+			_elements_to_ifaces.erase(_ifaces_to_elements[iface]);
+		}
+	}
+
+	_ifaces_to_elements[iface] = elm;
+	_elements_to_ifaces.set(elm, iface);
+
+	return 0;
+
+}
+
 void EmpowerLVAPManager::send_busyness_trigger(uint32_t trigger_id, uint32_t iface, uint32_t current) {
 
     WritablePacket *p = Packet::make(sizeof(empower_busyness_trigger));
@@ -567,34 +742,25 @@ void EmpowerLVAPManager::send_img_response(int type, uint32_t graph_id,
 
 	// Select stations active on the specified resource element (iface_id)
 
-	Vector<DstInfo> neighbors;
-	_ers->lock.acquire_read();
+	RXStatsSnapshot *snapshot = _ers->acquire_snapshot();
+	const NeighborStatsTable *neighbors = 0;
+	int nb_neighbors = 0;
 
-	if (type == EMPOWER_PT_UCQM_RESPONSE) {
-		for (NTIter iter = _ers->stas.begin(); iter.live(); iter++) {
-			if (iter.value()._iface_id != iface_id) {
-				continue;
-			}
-			neighbors.push_back(iter.value());
-		}
-	} else {
-		for (NTIter iter = _ers->aps.begin(); iter.live(); iter++) {
-			if (iter.value()._iface_id != iface_id) {
-				continue;
-			}
-			neighbors.push_back(iter.value());
-		}
+	if (snapshot) {
+		neighbors = (type == EMPOWER_PT_UCQM_RESPONSE) ? &snapshot->_stas : &snapshot->_aps;
+		nb_neighbors = neighbors->count(iface_id);
 	}
 
-	_ers->lock.release_read();
-
-	int len = sizeof(empower_cqm_response) + neighbors.size() * sizeof(cqm_entry);
+	int len = sizeof(empower_cqm_response) + nb_neighbors * sizeof(cqm_entry);
 	WritablePacket *p = Packet::make(len);
 
 	if (!p) {
 		click_chatter("%{element} :: %s :: cannot make packet!",
 					  this,
 					  __func__);
+		if (snapshot) {
+			_ers->release_snapshot(snapshot);
+		}
 		return;
 	}
 
@@ -607,23 +773,17 @@ void EmpowerLVAPManager::send_img_response(int type, uint32_t graph_id,
 	imgs->set_seq(get_next_seq());
 	imgs->set_graph_id(graph_id);
 	imgs->set_wtp(_wtp);
-	imgs->set_nb_entries(neighbors.size());
+	imgs->set_nb_entries(nb_neighbors);
 
-	uint8_t *ptr = (uint8_t *) imgs;
-	ptr += sizeof(struct empower_cqm_response);
-
-	uint8_t *end = ptr + (len - sizeof(struct empower_cqm_response));
+	// the snapshot already holds the entries in wire format
+	if (nb_neighbors) {
+		uint8_t *ptr = (uint8_t *) imgs;
+		ptr += sizeof(struct empower_cqm_response);
+		memcpy(ptr, neighbors->wire(iface_id), nb_neighbors * sizeof(cqm_entry));
+	}
 
-	for (int i = 0; i < neighbors.size(); i++) {
-		assert (ptr <= end);
-		cqm_entry *entry = (cqm_entry *) ptr;
-		entry->set_sta(neighbors[i]._eth);
-		entry->set_last_rssi_avg(neighbors[i]._last_rssi);
-		entry->set_last_rssi_std(neighbors[i]._last_std);
-		entry->set_last_packets(neighbors[i]._last_packets);
-		entry->set_hist_packets(neighbors[i]._hist_packets);
-		entry->set_mov_rssi(neighbors[i]._sma_rssi->avg());
-		ptr += sizeof(struct cqm_entry);
+	if (snapshot) {
+		_ers->release_snapshot(snapshot);
 	}
 
 	send_message(p);
@@ -644,10 +804,15 @@ void EmpowerLVAPManager::send_busyness_response(uint32_t busyness_id, EtherAddre
 		return;
 	}
 
-	_ers->lock.acquire_read();
-	BusynessInfo *nfo = _ers->busyness.get_pointer(iface_id);
-	uint32_t busyness = (uint32_t) nfo->_sma_busyness->avg();
-	_ers->lock.release_read();
+	uint32_t busyness = 0;
+	RXStatsSnapshot *snapshot = _ers->acquire_snapshot();
+	if (snapshot) {
+		const BusynessStats *nfo = snapshot->busyness(iface_id);
+		if (nfo) {
+			busyness = nfo->_sma_busyness;
+		}
+		_ers->release_snapshot(snapshot);
+	}
 
 	int len = sizeof(empower_busyness_response);
 	WritablePacket *p = Packet::make(len);
@@ -676,50 +841,72 @@ void EmpowerLVAPManager::send_busyness_response(uint32_t busyness_id, EtherAddre
 
 void EmpowerLVAPManager::send_summary_trigger(SummaryTrigger * summary) {
 
-	int len = sizeof(empower_summary_trigger) + summary->_frames.size() * sizeof(summary_entry);
-	WritablePacket *p = Packet::make(len);
-
-	if (!p) {
-		click_chatter("%{element} :: %s :: cannot make packet!",
-				      this,
-				      __func__);
-		return;
+	int max_entries = (_summary_max_len - sizeof(empower_summary_trigger)) / sizeof(summary_entry);
+	if (max_entries > 0xffff) {
+		max_entries = 0xffff;
 	}
 
-	memset(p->data(), 0, p->length());
+	int nb_frames = summary->nb_frames();
+	int sent = 0;
 
-	empower_summary_trigger* request = (struct empower_summary_trigger *) (p->data());
-	request->set_version(_empower_version);
-	request->set_length(len);
-	request->set_type(EMPOWER_PT_SUMMARY_TRIGGER);
-	request->set_seq(get_next_seq());
-	request->set_trigger_id(summary->_trigger_id);
-	request->set_wtp(_wtp);
-	request->set_nb_frames(summary->_frames.size());
+	// an empty report is still sent so that drops are accounted for
+	do {
 
-	uint8_t *ptr = (uint8_t *) request;
-	ptr += sizeof(struct empower_summary_trigger);
-	uint8_t *end = ptr + (len - sizeof(struct empower_summary_trigger));
+		int nb_entries = nb_frames - sent;
+		if (nb_entries > max_entries) {
+			nb_entries = max_entries;
+		}
 
-	for (int i = 0; i < summary->_frames.size(); i++) {
-		assert (ptr <= end);
-		summary_entry *entry = (summary_entry *) ptr;
-		entry->set_ra(summary->_frames[i]._ra);
-		entry->set_ta(summary->_frames[i]._ta);
-		entry->set_tsft(summary->_frames[i]._tsft);
-		entry->set_flags(summary->_frames[i]._flags);
-		entry->set_seq(summary->_frames[i]._seq);
-		entry->set_rssi(summary->_frames[i]._rssi);
-		entry->set_rate(summary->_frames[i]._rate);
-		entry->set_length(summary->_frames[i]._length);
-		entry->set_type(summary->_frames[i]._type);
-		entry->set_subtype(summary->_frames[i]._subtype);
-		ptr += sizeof(struct summary_entry);
-	}
-
-	summary->_frames.clear();
+		int len = sizeof(empower_summary_trigger) + nb_entries * sizeof(summary_entry);
+		WritablePacket *p = Packet::make(len);
 
-	send_message(p);
+		if (!p) {
+			click_chatter("%{element} :: %s :: cannot make packet!",
+						  this,
+						  __func__);
+			break;
+		}
+
+		memset(p->data(), 0, p->length());
+
+		empower_summary_trigger* request = (struct empower_summary_trigger *) (p->data());
+		request->set_version(_empower_version);
+		request->set_length(len);
+		request->set_type(EMPOWER_PT_SUMMARY_TRIGGER);
+		request->set_seq(get_next_seq());
+		request->set_trigger_id(summary->_trigger_id);
+		request->set_wtp(_wtp);
+		request->set_nb_frames(nb_entries);
+		request->set_nb_dropped(sent == 0 ? summary->_dropped : 0);
+
+		uint8_t *ptr = (uint8_t *) request;
+		ptr += sizeof(struct empower_summary_trigger);
+		uint8_t *end = ptr + (len - sizeof(struct empower_summary_trigger));
+
+		for (int i = sent; i < sent + nb_entries; i++) {
+			assert (ptr <= end);
+			const Frame &frame = summary->frame(i);
+			summary_entry *entry = (summary_entry *) ptr;
+			entry->set_ra(frame._ra);
+			entry->set_ta(frame._ta);
+			entry->set_tsft(frame._tsft);
+			entry->set_flags(frame._flags);
+			entry->set_seq(frame._seq);
+			entry->set_rssi(frame._rssi);
+			entry->set_rate(frame._rate);
+			entry->set_length(frame._length);
+			entry->set_type(frame._type);
+			entry->set_subtype(frame._subtype);
+			ptr += sizeof(struct summary_entry);
+		}
+
+		sent += nb_entries;
+
+		send_message(p);
+
+	} while (sent < nb_frames);
+
+	summary->clear_frames();
 
 }
 
@@ -736,7 +923,7 @@ void EmpowerLVAPManager::send_lvap_stats_response(EtherAddress lvap, uint32_t lv
 		return;
 	}
 
-	int len = sizeof(empower_lvap_stats_response) + nfo->rates.size() * sizeof(lvap_stats_entry);
+	int len = sizeof(empower_lvap_stats_response) + nfo->nb_rates * sizeof(lvap_stats_entry);
 	WritablePacket *p = Packet::make(len);
 
 	if (!p) {
@@ -755,13 +942,13 @@ void EmpowerLVAPManager::send_lvap_stats_response(EtherAddress lvap, uint32_t lv
 	lvap_stats->set_seq(get_next_seq());
 	lvap_stats->set_lvap_stats_id(lvap_stats_id);
 	lvap_stats->set_wtp(_wtp);
-	lvap_stats->set_nb_entries(nfo->rates.size());
+	lvap_stats->set_nb_entries(nfo->nb_rates);
 
 	uint8_t *ptr = (uint8_t *) lvap_stats;
 	ptr += sizeof(struct empower_lvap_stats_response);
 	uint8_t *end = ptr + (len - sizeof(struct empower_lvap_stats_response));
 
-	for (int i = 0; i < nfo->rates.size(); i++) {
+	for (int i = 0; i < nfo->nb_rates; i++) {
 		assert (ptr <= end);
 		lvap_stats_entry *entry = (lvap_stats_entry *) ptr;
 		entry->set_rate(nfo->rates[i]);
@@ -786,9 +973,12 @@ void EmpowerLVAPManager::send_counters_response(EtherAddress sta, uint32_t count
 		return;
 	}
 
+	int nb_tx = txp->_tx.nb_entries();
+	int nb_rx = txp->_rx.nb_entries();
+
 	int len = sizeof(empower_counters_response);
-	len += txp->_tx.size() * 6; // the tx samples
-	len += txp->_rx.size() * 6; // the rx samples
+	len += nb_tx * sizeof(struct counters_entry); // the tx bins
+	len += nb_rx * sizeof(struct counters_entry); // the rx bins
 
 	WritablePacket *p = Packet::make(len);
 
@@ -809,30 +999,94 @@ void EmpowerLVAPManager::send_counters_response(EtherAddress sta, uint32_t count
 	counters->set_counters_id(counters_id);
 	counters->set_wtp(_wtp);
 	counters->set_sta(sta);
-	counters->set_nb_tx(txp->_tx.size());
-	counters->set_nb_rx(txp->_rx.size());
+	counters->set_nb_tx(nb_tx);
+	counters->set_nb_rx(nb_rx);
 
 	uint8_t *ptr = (uint8_t *) counters;
 	ptr += sizeof(struct empower_counters_response);
 
 	uint8_t *end = ptr + (len - sizeof(struct empower_counters_response));
 
-	for (CBytesIter iter = txp->_tx.begin(); iter.live(); iter++) {
-		assert (ptr <= end);
+	for (int i = 0; i < txp->_tx.nb_bins(); i++) {
+		if (!txp->_tx.count(i)) {
+			continue;
+		}
+		assert (ptr < end);
 		counters_entry *entry = (counters_entry *) ptr;
-		entry->set_size(iter.key());
-		entry->set_count(iter.value());
+		entry->set_size(txp->_tx.mean_size(i));
+		entry->set_count(txp->_tx.count(i));
 		ptr += sizeof(struct counters_entry);
 	}
 
-	for (CBytesIter iter = txp->_rx.begin(); iter.live(); iter++) {
-		assert (ptr <= end);
+	for (int i = 0; i < txp->_rx.nb_bins(); i++) {
+		if (!txp->_rx.count(i)) {
+			continue;
+		}
+		assert (ptr < end);
 		counters_entry *entry = (counters_entry *) ptr;
-		entry->set_size(iter.key());
-		entry->set_count(iter.value());
+		entry->set_size(txp->_rx.mean_size(i));
+		entry->set_count(txp->_rx.count(i));
 		ptr += sizeof(struct counters_entry);
 	}
 
+	if (_counters_reset) {
+		txp->_tx.reset();
+		txp->_rx.reset();
+	}
+
+	send_message(p);
+
+}
+
+void EmpowerLVAPManager::send_lvap_aqm_stats_response(EtherAddress sta, uint32_t aqm_stats_id) {
+
+	EmpowerStationState *ess = _lvaps.get_pointer(sta);
+
+	if (!ess) {
+		click_chatter("%{element} :: %s :: unknown LVAP %s ignoring",
+					  this,
+					  __func__,
+					  sta.unparse_colon().c_str());
+		return;
+	}
+
+	AirtimeStation stats;
+
+	if (!_aqs.size() || !_aqs[ess->_iface_id]->station_stats(sta, stats)) {
+		click_chatter("%{element} :: %s :: no queue for LVAP %s",
+					  this,
+					  __func__,
+					  sta.unparse_colon().c_str());
+		return;
+	}
+
+	WritablePacket *p = Packet::make(sizeof(empower_lvap_aqm_stats_response));
+
+	if (!p) {
+		click_chatter("%{element} :: %s :: cannot make packet!",
+					  this,
+					  __func__);
+		return;
+	}
+
+	memset(p->data(), 0, p->length());
+
+	empower_lvap_aqm_stats_response *resp = (struct empower_lvap_aqm_stats_response *) (p->data());
+	resp->set_version(_empower_version);
+	resp->set_length(sizeof(empower_lvap_aqm_stats_response));
+	resp->set_type(EMPOWER_PT_LVAP_AQM_STATS_RESPONSE);
+	resp->set_seq(get_next_seq());
+	resp->set_aqm_stats_id(aqm_stats_id);
+	resp->set_wtp(_wtp);
+	resp->set_sta(sta);
+	resp->set_queue_length(stats._length);
+	resp->set_packets(stats._packets);
+	resp->set_drops(stats._drops);
+	resp->set_codel_drops(stats._codel_drops);
+	resp->set_sojourn_p50(stats._sojourn.percentile(50));
+	resp->set_sojourn_p90(stats._sojourn.percentile(90));
+	resp->set_sojourn_p99(stats._sojourn.percentile(99));
+
 	send_message(p);
 
 }
@@ -846,12 +1100,13 @@ void EmpowerLVAPManager::send_wtp_counters_response(uint32_t counters_id) {
 
 	for (LVAPIter it = _lvaps.begin(); it.live(); it++) {
 		TxPolicyInfo * txp = get_txp(it.key());
-		len += txp->_tx.size() * 12; // the tx samples
-		len += txp->_rx.size() * 12; // the rx samples
-		nb_tx += txp->_tx.size();
-		nb_rx += txp->_rx.size();
+		nb_tx += txp->_tx.nb_entries();
+		nb_rx += txp->_rx.nb_entries();
 	}
 
+	len += nb_tx * sizeof(struct wtp_counters_entry); // the tx bins
+	len += nb_rx * sizeof(struct wtp_counters_entry); // the rx bins
+
 	WritablePacket *p = Packet::make(len);
 
 	if (!p) {
@@ -880,11 +1135,14 @@ void EmpowerLVAPManager::send_wtp_counters_response(uint32_t counters_id) {
 
 	for (LVAPIter it = _lvaps.begin(); it.live(); it++) {
 		TxPolicyInfo * txp = get_txp(it.key());
-		for (CBytesIter iter = txp->_tx.begin(); iter.live(); iter++) {
+		for (int i = 0; i < txp->_tx.nb_bins(); i++) {
+			if (!txp->_tx.count(i)) {
+				continue;
+			}
 			assert (ptr <= end);
 			wtp_counters_entry *entry = (wtp_counters_entry *) ptr;
-			entry->set_size(iter.key());
-			entry->set_count(iter.value());
+			entry->set_size(txp->_tx.mean_size(i));
+			entry->set_count(txp->_tx.count(i));
 			entry->set_sta(it.key());
 			ptr += sizeof(struct wtp_counters_entry);
 		}
@@ -892,14 +1150,21 @@ void EmpowerLVAPManager::send_wtp_counters_response(uint32_t counters_id) {
 
 	for (LVAPIter it = _lvaps.begin(); it.live(); it++) {
 		TxPolicyInfo * txp = get_txp(it.key());
-		for (CBytesIter iter = txp->_rx.begin(); iter.live(); iter++) {
+		for (int i = 0; i < txp->_rx.nb_bins(); i++) {
+			if (!txp->_rx.count(i)) {
+				continue;
+			}
 			assert (ptr <= end);
 			wtp_counters_entry *entry = (wtp_counters_entry *) ptr;
-			entry->set_size(iter.key());
-			entry->set_count(iter.value());
+			entry->set_size(txp->_rx.mean_size(i));
+			entry->set_count(txp->_rx.count(i));
 			entry->set_sta(it.key());
 			ptr += sizeof(struct wtp_counters_entry);
 		}
+		if (_counters_reset) {
+			txp->_tx.reset();
+			txp->_rx.reset();
+		}
 	}
 
 	send_message(p);
@@ -1075,8 +1340,10 @@ void EmpowerLVAPManager::send_txp_counters_response(uint32_t counters_id, EtherA
 		return;
 	}
 
+	int nb_tx = tx_policy->_tx.nb_entries();
+
 	int len = sizeof(empower_txp_counters_response);
-	len += tx_policy->_tx.size() * 6; // the tx samples
+	len += nb_tx * sizeof(struct counters_entry); // the tx bins
 
 	WritablePacket *p = Packet::make(len);
 
@@ -1096,21 +1363,28 @@ void EmpowerLVAPManager::send_txp_counters_response(uint32_t counters_id, EtherA
 	counters->set_seq(get_next_seq());
 	counters->set_counters_id(counters_id);
 	counters->set_wtp(_wtp);
-	counters->set_nb_tx(tx_policy->_tx.size());
+	counters->set_nb_tx(nb_tx);
 
 	uint8_t *ptr = (uint8_t *) counters;
 	ptr += sizeof(struct empower_txp_counters_response);
 
 	uint8_t *end = ptr + (len - sizeof(struct empower_txp_counters_response));
 
-	for (CBytesIter iter = tx_policy->_tx.begin(); iter.live(); iter++) {
-		assert (ptr <= end);
+	for (int i = 0; i < tx_policy->_tx.nb_bins(); i++) {
+		if (!tx_policy->_tx.count(i)) {
+			continue;
+		}
+		assert (ptr < end);
 		counters_entry *entry = (counters_entry *) ptr;
-		entry->set_size(iter.key());
-		entry->set_count(iter.value());
+		entry->set_size(tx_policy->_tx.mean_size(i));
+		entry->set_count(tx_policy->_tx.count(i));
 		ptr += sizeof(struct counters_entry);
 	}
 
+	if (_counters_reset) {
+		tx_policy->_tx.reset();
+	}
+
 	send_message(p);
 
 }
@@ -1152,9 +1426,9 @@ void EmpowerLVAPManager::send_caps() {
 
 	uint8_t *end = ptr + (len - sizeof(struct empower_caps));
 
-	for (REIter iter = _ifaces_to_elements.begin(); iter.live(); iter++) {
+	for (int i = 0; i < _ifaces_to_elements.size(); i++) {
 		assert (ptr <= end);
-		ResourceElement *elm = iter.value();
+		ResourceElement *elm = &_ifaces_to_elements[i];
 		resource_elements_entry *entry = (resource_elements_entry *) ptr;
 		entry->set_hwaddr(elm->_hwaddr);
 		entry->set_channel(elm->_channel);
@@ -1199,8 +1473,7 @@ int EmpowerLVAPManager::handle_vap_status_request(Packet *, uint32_t) {
 
 int EmpowerLVAPManager::handle_port_status_request(Packet *, uint32_t) {
 	// send tx policies
-	for (REIter it_re = _ifaces_to_elements.begin(); it_re.live(); it_re++) {
-		int iface_id = it_re.key();
+	for (int iface_id = 0; iface_id < _ifaces_to_elements.size(); iface_id++) {
 		for (TxTableIter it_txp = get_tx_policies(iface_id)->tx_table()->begin(); it_txp.live(); it_txp++) {
 			EtherAddress sta = it_txp.key();
 			send_status_port(sta, iface_id);
@@ -1209,6 +1482,57 @@ int EmpowerLVAPManager::handle_port_status_request(Packet *, uint32_t) {
 	return 0;
 }
 
+int EmpowerLVAPManager::handle_set_airtime_quantum(Packet *p, uint32_t offset) {
+
+	struct empower_set_airtime_quantum *q = (struct empower_set_airtime_quantum *) (p->data() + offset);
+
+	EtherAddress sta = q->sta();
+	uint32_t quantum = q->quantum();
+
+	EmpowerStationState *ess = _lvaps.get_pointer(sta);
+
+	if (!ess) {
+		click_chatter("%{element} :: %s :: unknown LVAP %s ignoring",
+					  this,
+					  __func__,
+					  sta.unparse_colon().c_str());
+		return 0;
+	}
+
+	if (_debug) {
+		click_chatter("%{element} :: %s :: sta %s quantum %u",
+					  this,
+					  __func__,
+					  sta.unparse_colon().c_str(),
+					  quantum);
+	}
+
+	ess->_airtime_quantum = quantum;
+
+	if (_aqs.size()) {
+		_aqs[ess->_iface_id]->set_quantum(sta, quantum);
+	}
+
+	return 0;
+
+}
+
+int EmpowerLVAPManager::handle_lvap_aqm_stats_request(Packet *p, uint32_t offset) {
+	struct empower_lvap_aqm_stats_request *q = (struct empower_lvap_aqm_stats_request *) (p->data() + offset);
+	send_lvap_aqm_stats_response(q->sta(), q->aqm_stats_id());
+	return 0;
+}
+
+// Must be called whenever an LVAP changes interface, its downlink queue
+// (and CoDel state) moves to the airtime queue of the new interface.
+void EmpowerLVAPManager::move_lvap_queue(EmpowerStationState *ess, int old_iface) {
+	if (!_aqs.size() || old_iface == ess->_iface_id) {
+		return;
+	}
+	_aqs[old_iface]->remove_station(ess->_sta);
+	_aqs[ess->_iface_id]->add_station(ess->_sta, ess->_airtime_quantum);
+}
+
 int EmpowerLVAPManager::handle_add_vap(Packet *p, uint32_t offset) {
 
 	struct empower_add_vap *add_vap = (struct empower_add_vap *) (p->data() + offset);
@@ -1250,8 +1574,9 @@ int EmpowerLVAPManager::handle_add_vap(Packet *p, uint32_t offset) {
 		state._iface_id = iface;
 		_vaps.set(net_bssid, state);
 
-		/* Regenerate the BSSID mask */
-		compute_bssid_mask();
+		/* Add the BSSID to the mask */
+		_masks[iface].add(net_bssid);
+		schedule_bssid_masks();
 
 		return 0;
 
@@ -1283,10 +1608,13 @@ int EmpowerLVAPManager::handle_del_vap(Packet *p, uint32_t offset) {
 		return -1;
 	}
 
-	_vaps.erase(_vaps.find(net_bssid));
+	EmpowerVAPState *vap = _vaps.get_pointer(net_bssid);
 
 	// Remove this VAP's BSSID from the mask
-	compute_bssid_mask();
+	_masks[vap->_iface_id].remove(net_bssid);
+	schedule_bssid_masks();
+
+	_vaps.erase(_vaps.find(net_bssid));
 
 	return 0;
 
@@ -1388,6 +1716,7 @@ int EmpowerLVAPManager::handle_add_lvap(Packet *p, uint32_t offset) {
 		state._set_mask = set_mask;
 		state._ssid = ssid;
 		state._iface_id = iface;
+		update_txp(&state);
 
 		// set the CSA values to their default
 		state._csa_active = false;
@@ -1401,10 +1730,21 @@ int EmpowerLVAPManager::handle_add_lvap(Packet *p, uint32_t offset) {
 		state._add_lvap_module_id = 0;
 		state._del_lvap_module_id = 0;
 
+		state._mcast_iface = -1;
+		state._mask_iface = -1;
+
+		state._airtime_quantum = 0;
+
 		_lvaps.set(sta, state);
+		index_lvap(_lvaps.get_pointer(sta));
+
+		/* Add the BSSID to the mask */
+		mask_lvap(_lvaps.get_pointer(sta));
 
-		/* Regenerate the BSSID mask */
-		compute_bssid_mask();
+		/* Give the LVAP its own downlink queue */
+		if (_aqs.size()) {
+			_aqs[iface]->add_station(sta, state._airtime_quantum);
+		}
 
 		/* send add lvap response message */
 		send_add_del_lvap_response(EMPOWER_PT_ADD_LVAP_RESPONSE, state._sta, module_id, 0);
@@ -1466,6 +1806,9 @@ int EmpowerLVAPManager::handle_add_lvap(Packet *p, uint32_t offset) {
 	ess->_set_mask = set_mask;
 	ess->_ssid = ssid;
 
+	index_lvap(ess);
+	mask_lvap(ess);
+
 	/* send add lvap response message */
 	send_add_del_lvap_response(EMPOWER_PT_ADD_LVAP_RESPONSE, ess->_sta, module_id, 0);
 
@@ -1552,9 +1895,15 @@ int EmpowerLVAPManager::handle_set_port(Packet *p, uint32_t offset) {
 	_rcs[iface]->tx_policies()->insert(addr, mcs, ht_mcs, no_ack, tx_mcast, ur, rts_cts);
 	_rcs[iface]->forget_station(addr);
 
+	EmpowerStationState *ess = _lvaps.get_pointer(addr);
+
+	if (ess && ess->_iface_id == iface) {
+		update_txp(ess);
+	}
+
 	MinstrelDstInfo *nfo = _rcs.at(iface)->neighbors()->findp(addr);
 
-	if (!nfo || !nfo->rates.size()) {
+	if (!nfo || !nfo->nb_rates) {
 		if (_debug) {
 			click_chatter("%{element} :: %s :: adding %s",
 					      this,
@@ -1701,20 +2050,95 @@ int EmpowerLVAPManager::handle_del_lvap(Packet *p, uint32_t offset) {
 
 int EmpowerLVAPManager::remove_lvap(EmpowerStationState *ess) {
 
+	// Drop it from the broadcast/multicast index
+	unindex_lvap(ess);
+
+	// Remove this LVAP's BSSID from the mask
+	unmask_lvap(ess);
+
 	// Forget station
 	_rcs[ess->_iface_id]->tx_policies()->tx_table()->erase(ess->_sta);
 	_rcs[ess->_iface_id]->forget_station(ess->_sta);
 
+	// Drop its downlink queue
+	if (_aqs.size()) {
+		_aqs[ess->_iface_id]->remove_station(ess->_sta);
+	}
+
 	// Erase lvap
 	_lvaps.erase(_lvaps.find(ess->_sta));
 
-	// Remove this VAP's BSSID from the mask
-	compute_bssid_mask();
-
 	return 0;
 
 }
 
+void EmpowerLVAPManager::index_lvap(EmpowerStationState *ess) {
+
+	bool active = ess->_set_mask && ess->_authentication_status && ess->_association_status;
+
+	// nothing changed
+	if (active && ess->_mcast_iface == ess->_iface_id && ess->_mcast_bssid == ess->_lvap_bssid) {
+		return;
+	}
+
+	unindex_lvap(ess);
+
+	if (!active) {
+		return;
+	}
+
+	EmpowerIfaceIndex *idx = &_iface_index[ess->_iface_id];
+
+	idx->_stas.push_back(ess->_sta);
+	idx->_stas_bssids.push_back(ess->_lvap_bssid);
+
+	int *refs = idx->_bssids_refs.get_pointer(ess->_lvap_bssid);
+	if (refs) {
+		(*refs)++;
+	} else {
+		idx->_bssids_refs.set(ess->_lvap_bssid, 1);
+		idx->_bssids.push_back(ess->_lvap_bssid);
+	}
+
+	ess->_mcast_iface = ess->_iface_id;
+	ess->_mcast_bssid = ess->_lvap_bssid;
+
+}
+
+void EmpowerLVAPManager::unindex_lvap(EmpowerStationState *ess) {
+
+	if (ess->_mcast_iface < 0) {
+		return;
+	}
+
+	EmpowerIfaceIndex *idx = &_iface_index[ess->_mcast_iface];
+
+	for (int i = 0; i < idx->_stas.size(); i++) {
+		if (idx->_stas[i] == ess->_sta) {
+			idx->_stas[i] = idx->_stas.back();
+			idx->_stas_bssids[i] = idx->_stas_bssids.back();
+			idx->_stas.pop_back();
+			idx->_stas_bssids.pop_back();
+			break;
+		}
+	}
+
+	int *refs = idx->_bssids_refs.get_pointer(ess->_mcast_bssid);
+	if (refs && --(*refs) == 0) {
+		idx->_bssids_refs.erase(ess->_mcast_bssid);
+		for (int i = 0; i < idx->_bssids.size(); i++) {
+			if (idx->_bssids[i] == ess->_mcast_bssid) {
+				idx->_bssids[i] = idx->_bssids.back();
+				idx->_bssids.pop_back();
+				break;
+			}
+		}
+	}
+
+	ess->_mcast_iface = -1;
+
+}
+
 int EmpowerLVAPManager::handle_probe_response(Packet *p, uint32_t offset) {
 
 	struct empower_probe_response *q = (struct empower_probe_response *) (p->data() + offset);
@@ -1756,6 +2180,7 @@ int EmpowerLVAPManager::handle_auth_response(Packet *p, uint32_t offset) {
 	EmpowerStationState *ess = _lvaps.get_pointer(sta);
 	ess->_authentication_status = true;
 	ess->_association_status = false;
+	index_lvap(ess);
 	_eauthr->send_auth_response(ess->_sta, 2, WIFI_STATUS_SUCCESS, ess->_iface_id);
 	return 0;
 }
@@ -1931,98 +2356,44 @@ void EmpowerLVAPManager::push(int, Packet *p) {
 
 	uint32_t offset = 0;
 
-	while (offset < p->length()) {
+	/* A packet may carry several back-to-back messages, each one is
+	 * checked against the bytes left before being dispatched.
+	 */
+	while (offset + sizeof(struct empower_header) <= p->length()) {
 		struct empower_header *w = (struct empower_header *) (p->data() + offset);
-		switch (w->type()) {
-		case EMPOWER_PT_HELLO:
-			handle_empower_hello(p, offset);
-			break;
-		case EMPOWER_PT_ADD_LVAP:
-			handle_add_lvap(p, offset);
-			break;
-		case EMPOWER_PT_DEL_LVAP:
-			handle_del_lvap(p, offset);
-			break;
-		case EMPOWER_PT_ADD_VAP:
-			handle_add_vap(p, offset);
-			break;
-		case EMPOWER_PT_DEL_VAP:
-			handle_del_vap(p, offset);
-			break;
-		case EMPOWER_PT_PROBE_RESPONSE:
-			handle_probe_response(p, offset);
-			break;
-		case EMPOWER_PT_AUTH_RESPONSE:
-			handle_auth_response(p, offset);
-			break;
-		case EMPOWER_PT_ASSOC_RESPONSE:
-			handle_assoc_response(p, offset);
-			break;
-		case EMPOWER_PT_COUNTERS_REQUEST:
-			handle_counters_request(p, offset);
-			break;
-		case EMPOWER_PT_WTP_COUNTERS_REQUEST:
-			handle_wtp_counters_request(p, offset);
-			break;
-		case EMPOWER_PT_TXP_COUNTERS_REQUEST:
-			handle_txp_counters_request(p, offset);
-			break;
-		case EMPOWER_PT_ADD_RSSI_TRIGGER:
-			handle_add_rssi_trigger(p, offset);
-			break;
-		case EMPOWER_PT_DEL_RSSI_TRIGGER:
-			handle_del_rssi_trigger(p, offset);
-			break;
-		case EMPOWER_PT_ADD_BUSYNESS_TRIGGER:
-			handle_add_busyness_trigger(p, offset);
-			break;
-		case EMPOWER_PT_DEL_BUSYNESS_TRIGGER:
-			handle_del_busyness_trigger(p, offset);
-			break;
-		case EMPOWER_PT_ADD_SUMMARY_TRIGGER:
-			handle_add_summary_trigger(p, offset);
-			break;
-		case EMPOWER_PT_DEL_SUMMARY_TRIGGER:
-			handle_del_summary_trigger(p, offset);
-			break;
-		case EMPOWER_PT_UCQM_REQUEST:
-			handle_uimg_request(p, offset);
-			break;
-		case EMPOWER_PT_NCQM_REQUEST:
-			handle_nimg_request(p, offset);
-			break;
-		case EMPOWER_PT_SET_PORT:
-			handle_set_port(p, offset);
-			break;
-		case EMPOWER_PT_LVAP_STATS_REQUEST:
-			handle_lvap_stats_request(p, offset);
-			break;
-		case EMPOWER_PT_BUSYNESS_REQUEST:
-			handle_busyness_request(p, offset);
-			break;
-		case EMPOWER_PT_INCOM_MCAST_RESPONSE:
-			handle_incom_mcast_addr_response(p, offset);
-			break;
-		case EMPOWER_PT_CQM_LINKS_REQUEST:
-			handle_cqm_links_request(p, offset);
-			break;
-		case EMPOWER_PT_CAPS_REQUEST:
-			handle_caps_request(p, offset);
-			break;
-		case EMPOWER_PT_LVAP_STATUS_REQ:
-			handle_lvap_status_request(p, offset);
-			break;
-		case EMPOWER_PT_VAP_STATUS_REQ:
-			handle_vap_status_request(p, offset);
-			break;
-		case EMPOWER_PT_PORT_STATUS_REQ:
-			handle_port_status_request(p, offset);
+		if (w->length() < sizeof(struct empower_header) || w->length() > p->length() - offset) {
+			click_chatter("%{element} :: %s :: Truncated message type %d: %u Vs. %u",
+					      this,
+					      __func__,
+					      w->type(),
+					      w->length(),
+					      p->length() - offset);
 			break;
-		default:
+		}
+		const MessageType *mt = _dispatch[w->type()];
+		if (!mt) {
 			click_chatter("%{element} :: %s :: Unknown packet type: %d",
 					      this,
 					      __func__,
 					      w->type());
+			_nb_unknown_messages++;
+		} else if (w->version() != mt->_version || w->length() < mt->_min_length) {
+			click_chatter("%{element} :: %s :: Invalid %s message: version %d length %u Vs. version %d length %u",
+					      this,
+					      __func__,
+					      mt->_name,
+					      w->version(),
+					      w->length(),
+					      mt->_version,
+					      mt->_min_length);
+			_nb_invalid_messages++;
+		} else {
+			MessageStats &ms = _message_stats[mt->_type];
+			Timestamp start = Timestamp::now_steady();
+			(this->*(mt->_handler))(p, offset);
+			ms._time += Timestamp::now_steady() - start;
+			ms._messages++;
+			ms._bytes += w->length();
 		}
 		offset += w->length();
 	}
@@ -2043,89 +2414,95 @@ Vector<EtherAddress>::iterator find(Vector<EtherAddress>::iterator begin, Vector
 	return begin;
 }
 
-/*
- * This re-computes the BSSID mask for this node
- * using all the BSSIDs of the VAPs, and sets the
- * hardware register accordingly.
- */
-void EmpowerLVAPManager::compute_bssid_mask() {
+void EmpowerLVAPManager::mask_lvap(EmpowerStationState *ess) {
 
-	// clear _masks vector
-	_masks.clear();
+	// nothing changed
+	if (ess->_set_mask && ess->_mask_iface == ess->_iface_id && ess->_mask_bssid == ess->_net_bssid) {
+		return;
+	}
 
-	for (unsigned j = 0; j < _ifaces_to_elements.size(); j++) {
+	unmask_lvap(ess);
 
-		// start building mask
-		uint8_t bssid_mask[6];
-		int i;
+	// uplink only lvaps do not take part in the mask
+	if (!ess->_set_mask) {
+		return;
+	}
 
-		// Start with a mask of ff:ff:ff:ff:ff:ff
-		for (i = 0; i < 6; i++) {
-			bssid_mask[i] = 0xff;
-		}
+	_masks[ess->_iface_id].add(ess->_net_bssid);
+	ess->_mask_iface = ess->_iface_id;
+	ess->_mask_bssid = ess->_net_bssid;
 
-		// For each LVAP, update the bssid mask to include
-		// the common bits of all LVAPs.
-		for (LVAPIter it = _lvaps.begin(); it.live(); it++) {
-			// check iface
-			unsigned iface_id = it.value()._iface_id;
-			if (iface_id != j) {
-				continue;
-			}
-			// check set mask flag
-			bool set_mask = it.value()._set_mask;
-			if (!set_mask) {
-				continue;
-			}
-			// add to mask
-			for (i = 0; i < 6; i++) {
-				const uint8_t *hw = (const uint8_t *) _ifaces_to_elements[iface_id]->_hwaddr.data();
-				const uint8_t *bssid = (const uint8_t *) it.value()._net_bssid.data();
-				bssid_mask[i] &= ~(hw[i] ^ bssid[i]);
-			}
-		}
+	schedule_bssid_masks();
 
-		// For each VAP, update the bssid mask to include
-		// the common bits of all VAPs.
-		for (VAPIter it = _vaps.begin(); it.live(); it++) {
-			// check iface
-			unsigned iface_id = it.value()._iface_id;
-			if (iface_id != j) {
-				continue;
-			}
-			// add to mask
-			for (i = 0; i < 6; i++) {
-				const uint8_t *hw = (const uint8_t *) _ifaces_to_elements[iface_id]->_hwaddr.data();
-				const uint8_t *bssid = (const uint8_t *) it.value()._net_bssid.data();
-				bssid_mask[i] &= ~(hw[i] ^ bssid[i]);
-			}
-		}
+}
 
-		_masks.push_back(EtherAddress(bssid_mask));
+void EmpowerLVAPManager::unmask_lvap(EmpowerStationState *ess) {
 
+	if (ess->_mask_iface < 0) {
+		return;
 	}
 
-	// Update bssid masks register through debugfs
+	_masks[ess->_mask_iface].remove(ess->_mask_bssid);
+	ess->_mask_iface = -1;
+
+	schedule_bssid_masks();
+
+}
+
+void EmpowerLVAPManager::schedule_bssid_masks() {
+	// coalesce bursts of lvap changes into a single write
+	if (!_mask_timer.scheduled()) {
+		_mask_timer.schedule_after_msec(_mask_delay);
+	}
+}
+
+/*
+ * Writes the BSSID masks that changed since the last
+ * write to the hardware registers through debugfs.
+ */
+void EmpowerLVAPManager::write_bssid_masks() {
+
 	for (int i = 0; i < _masks.size(); i++) {
 
-		FILE *debugfs_file = fopen(_debugfs_strings[i].c_str(), "w");
+		EmpowerBSSIDMask *mask = &_masks[i];
 
-		if (debugfs_file != NULL) {
-			if (_debug) {
-				click_chatter("%{element} :: %s :: %s",
-							  this,
-							  __func__,
-							  _masks[i].unparse_colon().c_str());
-			}
-			fprintf(debugfs_file, "%s\n", _masks[i].unparse_colon().c_str());
-			fclose(debugfs_file);
+		if (mask->synced()) {
 			continue;
 		}
 
-		click_chatter("%{element} :: %s :: unable to open debugfs file %s",
-					  this,
-					  __func__,
-					  _debugfs_strings[i].c_str());
+		if (mask->_fd < 0) {
+			mask->_fd = open(_debugfs_strings[i].c_str(), O_WRONLY);
+		}
+
+		if (mask->_fd < 0) {
+			click_chatter("%{element} :: %s :: unable to open debugfs file %s",
+						  this,
+						  __func__,
+						  _debugfs_strings[i].c_str());
+			continue;
+		}
+
+		if (_debug) {
+			click_chatter("%{element} :: %s :: %s",
+						  this,
+						  __func__,
+						  mask->_mask.unparse_colon().c_str());
+		}
+
+		String value = mask->_mask.unparse_colon() + "\n";
+
+		if (pwrite(mask->_fd, value.data(), value.length(), 0) < 0) {
+			click_chatter("%{element} :: %s :: unable to write debugfs file %s",
+						  this,
+						  __func__,
+						  _debugfs_strings[i].c_str());
+			close(mask->_fd);
+			mask->_fd = -1;
+			continue;
+		}
+
+		mask->_written = mask->_mask;
+		mask->_has_written = true;
 
 	}
 
@@ -2142,6 +2519,7 @@ enum {
 	H_DEL_LVAP,
 	H_RECONNECT,
 	H_INTERFACES,
+	H_MESSAGES,
 };
 
 String EmpowerLVAPManager::read_handler(Element *e, void *thunk) {
@@ -2160,7 +2538,7 @@ String EmpowerLVAPManager::read_handler(Element *e, void *thunk) {
 	case H_MASKS: {
 	    StringAccum sa;
 	    for (int i = 0; i < td->_masks.size(); i++) {
-	    	sa << i << ": " << td->_masks[i].unparse() << "\n";
+	    	sa << i << ": " << td->_masks[i]._mask.unparse() << "\n";
 	    }
 		return sa.take_string();
 	}
@@ -2211,9 +2589,24 @@ String EmpowerLVAPManager::read_handler(Element *e, void *thunk) {
 	}
 	case H_INTERFACES: {
 		StringAccum sa;
-		for (REIter iter = td->_ifaces_to_elements.begin(); iter.live(); iter++) {
-			sa << iter.key() << " -> " << iter.value()->unparse()  << "\n";
+		for (int i = 0; i < td->_ifaces_to_elements.size(); i++) {
+			sa << i << " -> " << td->_ifaces_to_elements[i].unparse()  << "\n";
+		}
+		return sa.take_string();
+	}
+	case H_MESSAGES: {
+		StringAccum sa;
+		for (int i = 0; i < _nb_message_types; i++) {
+			const MessageType *mt = &_message_types[i];
+			const MessageStats &ms = td->_message_stats[mt->_type];
+			sa << mt->_name;
+			sa << " messages " << ms._messages;
+			sa << " bytes " << ms._bytes;
+			sa << " usec " << ms._time.usecval();
+			sa << "\n";
 		}
+		sa << "unknown " << td->_nb_unknown_messages << "\n";
+		sa << "invalid " << td->_nb_invalid_messages << "\n";
 		return sa.take_string();
 	}
 	case H_VAPS: {
@@ -2241,26 +2634,16 @@ String EmpowerLVAPManager::read_handler(Element *e, void *thunk) {
 			TxPolicyInfo *txp = td->get_txp(it.key());
 			sa << "!" << it.key().unparse() << "\n";
 			sa << "!TX\n";
-			CBytes tx = txp->_tx;
-			Vector<int> lens_tx;
-			for (CBytesIter iter = tx.begin(); iter.live(); iter++) {
-				lens_tx.push_back(iter.key());
-			}
-			click_qsort(lens_tx.begin(), lens_tx.size());
-			for (int i = 0; i < lens_tx.size(); i++) {
-				CBytesIter itr = tx.find(lens_tx[i]);
-				sa << itr.key() << " " << itr.value() << "\n";
+			for (int i = 0; i < txp->_tx.nb_bins(); i++) {
+				if (txp->_tx.count(i)) {
+					sa << txp->_tx.mean_size(i) << " " << txp->_tx.count(i) << "\n";
+				}
 			}
 			sa << "!RX\n";
-			CBytes rx = txp->_rx;
-			Vector<int> lens_rx;
-			for (CBytesIter iter = rx.begin(); iter.live(); iter++) {
-				lens_rx.push_back(iter.key());
-			}
-			click_qsort(lens_rx.begin(), lens_rx.size());
-			for (int i = 0; i < lens_rx.size(); i++) {
-				CBytesIter itr = rx.find(lens_rx[i]);
-				sa << itr.key() << " " << itr.value() << "\n";
+			for (int i = 0; i < txp->_rx.nb_bins(); i++) {
+				if (txp->_rx.count(i)) {
+					sa << txp->_rx.mean_size(i) << " " << txp->_rx.count(i) << "\n";
+				}
 			}
 		}
 		return sa.take_string();
@@ -2340,6 +2723,7 @@ void EmpowerLVAPManager::add_handlers() {
 	add_read_handler("masks", read_handler, (void *) H_MASKS);
 	add_read_handler("bytes", read_handler, (void *) H_BYTES);
 	add_read_handler("interfaces", read_handler, (void *) H_INTERFACES);
+	add_read_handler("messages", read_handler, (void *) H_MESSAGES);
 	add_write_handler("reconnect", write_handler, (void *) H_RECONNECT);
 	add_write_handler("ports", write_handler, (void *) H_PORTS);
 	add_write_handler("debug", write_handler, (void *) H_DEBUG);
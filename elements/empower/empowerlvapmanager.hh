@@ -45,6 +45,11 @@ An EmpowerAssociationResponder element
 =item DEBUGFS
 The path to the bssid_extra file
 
+=item MASK_DELAY
+The BSSID masks are updated incrementally as LVAPs and VAPs come and go,
+and written to the bssid_extra files at most once every MASK_DELAY
+milliseconds, only if they changed. Default is 10
+
 =item EPSB
 An EmpowerPowerSaveBuffer element
 
@@ -57,6 +62,21 @@ An EmpowerDeAuthResponder element
 =item EDISASSOR
 An EmpowerDisassocResponder element
 
+=item COUNTERS_RESET
+Clear the frame size histograms after each counters response, so that the
+Access Controller receives per-interval deltas. Default is false
+
+=item AQS
+Space-separated list of EmpowerAirtimeQueue elements, one for each
+interface in the same order as RCS. Optional; when set, every LVAP gets
+its own queue (and CoDel state) when it is added, which is released when
+the LVAP is removed. The controller can then set the airtime quantum of
+an LVAP and query its drops and sojourn times.
+
+=item SUMMARY_MAX_LEN
+Maximum length in bytes of a summary trigger message. Larger batches are
+split over several messages. Default is 65536
+
 =item DEBUG
 Turn debug on/off
 
@@ -80,9 +100,6 @@ enum empower_bands_types {
     EMPOWER_BT_HT20 = 0x1,
 };
 
-typedef HashTable<uint16_t, uint32_t> CBytes;
-typedef CBytes::iterator CBytesIter;
-
 class Minstrel;
 
 class NetworkPort {
@@ -144,6 +161,8 @@ public:
 	empower_bands_types _supported_band;
 	empower_bands_types _target_band;
 	int _iface_id;
+	// tx policy of _sta on _iface_id, see update_txp()
+	TxPolicyInfo *_txp;
 	bool _set_mask;
 	bool _authentication_status;
 	bool _association_status;
@@ -156,6 +175,76 @@ public:
 	// ADD/DEL LVAP response entries
 	uint32_t _add_lvap_module_id;
 	uint32_t _del_lvap_module_id;
+	// interface and bssid this LVAP is indexed with for downlink
+	// broadcast/multicast traffic (-1 if not indexed), see index_lvap()
+	int _mcast_iface;
+	EtherAddress _mcast_bssid;
+	// interface and bssid this LVAP contributes to the bssid mask
+	// with (-1 if none), see mask_lvap()
+	int _mask_iface;
+	EtherAddress _mask_bssid;
+	// airtime granted per round by EmpowerAirtimeQueue (usec, 0 for
+	// the queue default)
+	uint32_t _airtime_quantum;
+};
+
+// BSSID mask of one interface. For every bit of the address it counts
+// the hosted BSSIDs that differ from the interface address in that bit,
+// the bit is cleared in the mask as long as the count is not zero.
+class EmpowerBSSIDMask {
+public:
+
+	EtherAddress _hwaddr;
+	uint32_t _refs[48];
+	EtherAddress _mask;
+	EtherAddress _written; // last mask written to debugfs
+	bool _has_written;
+	int _fd;
+
+	EmpowerBSSIDMask() : _mask(EtherAddress::make_broadcast()), _has_written(false), _fd(-1) {
+		memset(_refs, 0, sizeof(_refs));
+	}
+
+	void add(EtherAddress bssid) { update(bssid, 1); }
+	void remove(EtherAddress bssid) { update(bssid, -1); }
+
+	bool synced() const { return _has_written && _written == _mask; }
+
+private:
+
+	void update(EtherAddress bssid, int delta) {
+		const uint8_t *hw = _hwaddr.data();
+		const uint8_t *b = bssid.data();
+		uint8_t mask[6];
+		memcpy(mask, _mask.data(), 6);
+		for (int i = 0; i < 6; i++) {
+			uint8_t diff = hw[i] ^ b[i];
+			for (int j = 0; j < 8; j++) {
+				if (!(diff & (1 << j))) {
+					continue;
+				}
+				_refs[i * 8 + j] += delta;
+				if (_refs[i * 8 + j]) {
+					mask[i] &= ~(1 << j);
+				} else {
+					mask[i] |= (1 << j);
+				}
+			}
+		}
+		_mask = EtherAddress(mask);
+	}
+
+};
+
+// Stations on one interface that receive downlink broadcast/multicast
+// traffic (DL enabled, authenticated and associated) along with their
+// LVAP bssid, plus the unique bssids among them with a reference count
+class EmpowerIfaceIndex {
+public:
+	Vector<EtherAddress> _stas;
+	Vector<EtherAddress> _stas_bssids;
+	Vector<EtherAddress> _bssids;
+	HashTable<EtherAddress, int> _bssids_refs;
 };
 
 // Cross structure mapping bssids to list of associated
@@ -223,8 +312,9 @@ inline bool operator==(const ResourceElement &a, const ResourceElement &b) {
 	return a._hwaddr == b._hwaddr && a._channel == b._channel && a._band == b._band;
 }
 
-typedef HashTable<int, ResourceElement *> RETable;
-typedef RETable::const_iterator REIter;
+// Resource elements indexed by iface id, and the reverse index
+typedef Vector<ResourceElement> RETable;
+typedef HashTable<ResourceElement, int> REIndex;
 
 class EmpowerLVAPManager: public Element {
 public:
@@ -236,8 +326,13 @@ public:
 	const char *port_count() const { return "1/1"; }
 	const char *processing() const { return PUSH; }
 
+	// after TransmissionPolicies, so that take_state() finds the
+	// policies of the old configuration already moved
+	int configure_phase() const { return CONFIGURE_PHASE_DEFAULT + 1; }
+
 	int initialize(ErrorHandler *);
 	int configure(Vector<String> &, ErrorHandler *);
+	void take_state(Element *, ErrorHandler *);
 	void add_handlers();
 	void run_timer(Timer *);
 	void reset();
@@ -274,6 +369,8 @@ public:
 	int handle_lvap_status_request(Packet *, uint32_t);
 	int handle_vap_status_request(Packet *, uint32_t);
 	int handle_port_status_request(Packet *, uint32_t);
+	int handle_set_airtime_quantum(Packet *, uint32_t);
+	int handle_lvap_aqm_stats_request(Packet *, uint32_t);
 	int handle_empower_hello(Packet *, uint32_t);
 
 	void send_hello();
@@ -297,8 +394,14 @@ public:
 	void send_igmp_report(EtherAddress, Vector<IPAddress>*, Vector<enum empower_igmp_record_type>*);
 	void send_cqm_links_response(uint32_t);
 	void send_add_del_lvap_response(uint8_t, EtherAddress, uint32_t, uint32_t);
+	void send_lvap_aqm_stats_response(EtherAddress, uint32_t);
 
 	int remove_lvap(EmpowerStationState *);
+	void move_lvap_queue(EmpowerStationState *, int);
+	void index_lvap(EmpowerStationState *);
+	void unindex_lvap(EmpowerStationState *);
+	void mask_lvap(EmpowerStationState *);
+	void unmask_lvap(EmpowerStationState *);
 	LVAP* lvaps() { return &_lvaps; }
 	VAP* vaps() { return &_vaps; }
 	EtherAddress wtp() { return _wtp; }
@@ -306,18 +409,19 @@ public:
 	uint32_t get_next_seq() { return ++_seq; }
 
 	int element_to_iface(EtherAddress hwaddr, uint8_t channel, empower_bands_types band) {
-		for (REIter iter = _ifaces_to_elements.begin(); iter.live(); iter++) {
-			if (iter.value()->_hwaddr == hwaddr && iter.value()->_channel == channel && iter.value()->_band == band) {
-				return iter.key();
-			}
-		}
-		return -1;
+		const int *iface = _elements_to_ifaces.get_pointer(ResourceElement(hwaddr, channel, band));
+		return iface ? *iface : -1;
 	}
 
 	ResourceElement* iface_to_element(int iface) {
-		return _ifaces_to_elements.get(iface);
+		if (iface < 0 || iface >= _ifaces_to_elements.size()) {
+			return 0;
+		}
+		return &_ifaces_to_elements[iface];
 	}
 
+	int set_iface_element(int, const ResourceElement &);
+
 	int num_ifaces() {
 		return _rcs.size();
 	}
@@ -332,9 +436,18 @@ public:
 		if (!ess) {
 			return 0;
 		}
-		Minstrel * rc = _rcs[ess->_iface_id];
-		TxPolicyInfo * txp = rc->tx_policies()->lookup(ess->_sta);
-		return txp;
+		return ess->_txp;
+	}
+
+	// The data path reads the tx policy straight from the LVAP, this
+	// must be called whenever the LVAP changes interface or its policy
+	// is inserted on that interface.
+	void update_txp(EmpowerStationState *ess) {
+		ess->_txp = _rcs[ess->_iface_id]->tx_policies()->lookup(ess->_sta);
+	}
+
+	EmpowerIfaceIndex * iface_index(int iface_id) {
+		return &_iface_index[iface_id];
 	}
 
 	TransmissionPolicies * get_tx_policies(int iface_id) {
@@ -344,9 +457,41 @@ public:
 
 private:
 
+	/* Controller messages are dispatched through a static table
+	 * indexed by message type. Every entry states the protocol version
+	 * and the minimum length the handler relies on, so handlers never
+	 * see truncated messages.
+	 */
+	typedef int (EmpowerLVAPManager::*MessageHandler)(Packet *, uint32_t);
+
+	struct MessageType {
+		uint8_t _type;
+		uint8_t _version;
+		uint32_t _min_length;
+		MessageHandler _handler;
+		const char *_name;
+	};
+
+	struct MessageStats {
+		uint32_t _messages;
+		uint64_t _bytes;
+		Timestamp _time;
+		MessageStats() : _messages(0), _bytes(0) { }
+	};
+
+	static const MessageType _message_types[];
+	static const int _nb_message_types;
+
+	const MessageType *_dispatch[256];
+	MessageStats _message_stats[256];
+	uint32_t _nb_unknown_messages;
+	uint32_t _nb_invalid_messages;
+
 	RETable _ifaces_to_elements;
+	REIndex _elements_to_ifaces;
 
-	void compute_bssid_mask();
+	void schedule_bssid_masks();
+	void write_bssid_masks();
 
 	void send_message(Packet *);
 	bool notify_socket_restart();
@@ -363,14 +508,20 @@ private:
 	LVAP _lvaps;
 	Ports _ports;
 	VAP _vaps;
-	Vector<EtherAddress> _masks;
+	Vector<EmpowerBSSIDMask> _masks;
 	Vector<Minstrel *> _rcs;
+	Vector<class EmpowerAirtimeQueue *> _aqs;
+	Vector<EmpowerIfaceIndex> _iface_index;
 	Vector<String> _debugfs_strings;
 	Timer _timer;
+	Timer _mask_timer;
+	unsigned int _mask_delay; // msecs
 	uint32_t _seq;
 	EtherAddress _wtp;
 	unsigned int _period; // msecs
 	bool _debug;
+	bool _counters_reset; // clear the frame size histograms once reported
+	uint32_t _summary_max_len; // bytes per summary message
 	int _hello_seq_ctr;
 
 	static int write_handler(const String &, Element *, void *, ErrorHandler *);
@@ -44,8 +44,26 @@ int EmpowerMulticastTable::configure(Vector<String> &conf, ErrorHandler *errh) {
 
 }
 
+void EmpowerMulticastTable::take_state(Element *e, ErrorHandler *) {
+
+	EmpowerMulticastTable *q = (EmpowerMulticastTable *) e->cast("EmpowerMulticastTable");
+
+	if (!q) {
+		return;
+	}
+
+	multicastgroups.swap(q->multicastgroups);
+	mac_groups.swap(q->mac_groups);
+	sta_groups.swap(q->sta_groups);
+
+}
+
 bool EmpowerMulticastTable::addgroup(IPAddress group) {
 
+	if (multicastgroups.get_pointer(group)) {
+		return false;
+	}
+
 	const unsigned char *p = group.data();
 
 	click_chatter("%{element} :: %s :: Adding IGMP group %d.%d.%d.%d",
@@ -55,156 +73,253 @@ bool EmpowerMulticastTable::addgroup(IPAddress group) {
 
 	EmpowerMulticastGroup newgroup;
 	newgroup.group = group;
+	newgroup.mac_group = ip_mcast_addr_to_mac(group);
+	multicastgroups.set(group, newgroup);
 
-	Vector<EmpowerMulticastGroup>::iterator i;
-	for (i = multicastgroups.begin(); i != multicastgroups.end(); i++) {
-		if (IPAddress((*i).group) == IPAddress(group))
-			return false;
+	EmpowerMulticastMacGroup *mac = mac_groups.get_pointer(newgroup.mac_group);
+	if (!mac) {
+		mac_groups.set(newgroup.mac_group, EmpowerMulticastMacGroup());
+		mac = mac_groups.get_pointer(newgroup.mac_group);
 	}
+	mac->groups.push_back(group);
 
-	newgroup.mac_group = ip_mcast_addr_to_mac(group);
-	multicastgroups.push_back(newgroup);
+	return true;
+
+}
+
+void EmpowerMulticastTable::delgroup(EmpowerMulticastGroup *group) {
+
+	click_chatter("%{element} :: %s :: IGMP group %d.%d.%d.%d is empty. It is about to be deleted",
+				  this,
+				  __func__,
+				  group->group.data()[0],
+				  group->group.data()[1],
+				  group->group.data()[2],
+				  group->group.data()[3]);
+
+	EmpowerMulticastMacGroup *mac = mac_groups.get_pointer(group->mac_group);
+	if (mac) {
+		for (int i = 0; i < mac->groups.size(); i++) {
+			if (mac->groups[i] == group->group) {
+				mac->groups.erase(mac->groups.begin() + i);
+				break;
+			}
+		}
+		if (mac->groups.empty()) {
+			mac_groups.erase(group->mac_group);
+		}
+	}
+
+	multicastgroups.erase(group->group);
+
+}
+
+bool EmpowerMulticastTable::remove_receiver(Vector<EmpowerMulticastReceiver> &receivers,
+		HashTable<EtherAddress, int> &receivers_index, EtherAddress sta) {
+
+	int *pos = receivers_index.get_pointer(sta);
+	if (!pos) {
+		return false;
+	}
+
+	// move the last receiver in the freed position
+	int i = *pos;
+	receivers_index.erase(sta);
+	if (i != receivers.size() - 1) {
+		receivers[i] = receivers.back();
+		receivers_index.set(receivers[i].sta, i);
+	}
+	receivers.pop_back();
 
 	return true;
 
 }
 
+// A station is a receiver of a mac address as long as it is in at least
+// one of the ip groups mapping to it.
+void EmpowerMulticastTable::join_mac_group(EtherAddress mac_group, EtherAddress sta) {
+
+	EmpowerMulticastMacGroup *mac = mac_groups.get_pointer(mac_group);
+	if (!mac) {
+		return;
+	}
+
+	int *joined = mac->receivers_joined.get_pointer(sta);
+	if (joined) {
+		(*joined)++;
+		return;
+	}
+
+	EmpowerMulticastReceiver new_receiver;
+	new_receiver.sta = sta;
+	mac->receivers_joined.set(sta, 1);
+	mac->receivers_index.set(sta, mac->receivers.size());
+	mac->receivers.push_back(new_receiver);
+
+}
+
+void EmpowerMulticastTable::leave_mac_group(EtherAddress mac_group, EtherAddress sta) {
+
+	EmpowerMulticastMacGroup *mac = mac_groups.get_pointer(mac_group);
+	if (!mac) {
+		return;
+	}
+
+	int *joined = mac->receivers_joined.get_pointer(sta);
+	if (!joined) {
+		return;
+	}
+
+	if (--(*joined) == 0) {
+		mac->receivers_joined.erase(sta);
+		remove_receiver(mac->receivers, mac->receivers_index, sta);
+	}
+
+}
+
 bool EmpowerMulticastTable::joingroup(EtherAddress sta, IPAddress group)
 {
 
-	Vector<EmpowerMulticastGroup>::iterator i;
+	EmpowerMulticastGroup *i = multicastgroups.get_pointer(group);
 
-	for (i = multicastgroups.begin(); i != multicastgroups.end(); i++)
-	{
-		if ((*i).group.addr() == group.addr())
-		{
-			Vector<EmpowerMulticastReceiver>::iterator a;
-			for (a = (*i).receivers.begin(); a != (*i).receivers.end(); a++)
-			{
-				if ((*a).sta == sta)
-				{
-					click_chatter("%{element} :: %s :: Station %s already in IGMP group %d.%d.%d.%d!",
-							this, __func__, sta.unparse().c_str(), (*i).group.data()[0], (*i).group.data()[1],
-							(*i).group.data()[2], (*i).group.data()[3]);
-					return false;
-				}
-			}
-			EmpowerMulticastReceiver new_receiver;
-			new_receiver.sta = sta;
-			(*i).receivers.push_back(new_receiver);
-			click_chatter("%{element} :: %s :: Station %s added to IGMP group %d.%d.%d.%d!",
-					      this,
-						  __func__,
-						  sta.unparse().c_str(),
-						  (*i).group.data()[0],
-						  (*i).group.data()[1],
-						  (*i).group.data()[2],
-						  (*i).group.data()[3]);
-
-			return true;
-		}
+	if (!i) {
+		return false;
 	}
 
-	return false;
+	if (i->receivers_index.get_pointer(sta)) {
+		click_chatter("%{element} :: %s :: Station %s already in IGMP group %d.%d.%d.%d!",
+				this, __func__, sta.unparse().c_str(), i->group.data()[0], i->group.data()[1],
+				i->group.data()[2], i->group.data()[3]);
+		return false;
+	}
+
+	EmpowerMulticastReceiver new_receiver;
+	new_receiver.sta = sta;
+	i->receivers_index.set(sta, i->receivers.size());
+	i->receivers.push_back(new_receiver);
+	join_mac_group(i->mac_group, sta);
+
+	Vector<IPAddress> *groups = sta_groups.get_pointer(sta);
+	if (!groups) {
+		sta_groups.set(sta, Vector<IPAddress>());
+		groups = sta_groups.get_pointer(sta);
+	}
+	groups->push_back(group);
+
+	click_chatter("%{element} :: %s :: Station %s added to IGMP group %d.%d.%d.%d!",
+			      this,
+				  __func__,
+				  sta.unparse().c_str(),
+				  i->group.data()[0],
+				  i->group.data()[1],
+				  i->group.data()[2],
+				  i->group.data()[3]);
+
+	return true;
+
 }
 
 bool EmpowerMulticastTable::leavegroup(EtherAddress sta, IPAddress group)
 {
 
-	Vector<EmpowerMulticastGroup>::iterator i;
+	EmpowerMulticastGroup *i = multicastgroups.get_pointer(group);
 
-	for (i = multicastgroups.begin(); i != multicastgroups.end(); i++)
-	{
-		if ((*i).group.addr() == group.addr())
-		{
-			Vector<EmpowerMulticastReceiver>::iterator a;
-			for (a = (*i).receivers.begin(); a != (*i).receivers.end(); a++)
-			{
-				if ((*a).sta == sta)
-				{
-					(*i).receivers.erase(a);
-					click_chatter("%{element} :: %s :: Station %s added removed from IGMP group %d.%d.%d.%d",
-										this, __func__, sta.unparse().c_str(),
-										(*i).group.data()[0], (*i).group.data()[1],
-										(*i).group.data()[2], (*i).group.data()[3]);
-					// The group is deleted if no more receivers belong to it
-					if ((*i).receivers.begin() == (*i).receivers.end())
-					{
-						multicastgroups.erase(i);
-						click_chatter("%{element} :: %s :: IGMP group %d.%d.%d.%d is empty. It is about to be deleted",
-																this, __func__, (*i).group.data()[0], (*i).group.data()[1],
-																(*i).group.data()[2], (*i).group.data()[3]);
-					}
-					return true;
-				}
-			}
+	if (!i || !remove_receiver(i->receivers, i->receivers_index, sta)) {
+		click_chatter("%{element} :: %s :: IGMP leave group request received from station %s not found in group %d.%d.%d.%d",
+					  this, __func__, sta.unparse().c_str(), group.data()[0], group.data()[1],
+					  group.data()[2], group.data()[3]);
+		return false;
+	}
 
+	click_chatter("%{element} :: %s :: Station %s removed from IGMP group %d.%d.%d.%d",
+				  this, __func__, sta.unparse().c_str(),
+				  group.data()[0], group.data()[1],
+				  group.data()[2], group.data()[3]);
+
+	leave_mac_group(i->mac_group, sta);
+
+	Vector<IPAddress> *groups = sta_groups.get_pointer(sta);
+	if (groups) {
+		for (int j = 0; j < groups->size(); j++) {
+			if ((*groups)[j] == group) {
+				(*groups)[j] = groups->back();
+				groups->pop_back();
+				break;
+			}
+		}
+		if (groups->empty()) {
+			sta_groups.erase(sta);
 		}
 	}
-	click_chatter("%{element} :: %s :: IGMP leave group request received from station %s not found in group %d.%d.%d.%d",
-														this, __func__, sta.unparse().c_str(), (*i).group.data()[0], (*i).group.data()[1],
-														(*i).group.data()[2], (*i).group.data()[3]);
-	return false;
+
+	// The group is deleted if no more receivers belong to it
+	if (i->receivers.empty()) {
+		delgroup(i);
+	}
+
+	return true;
+
 }
 
 Vector<EmpowerMulticastTable::EmpowerMulticastReceiver>* EmpowerMulticastTable::getIGMPreceivers(EtherAddress group)
 {
-	Vector<struct EmpowerMulticastGroup>::iterator i;
 
-	for (i = multicastgroups.begin(); i != multicastgroups.end(); i++)
-	{
-		if (i->mac_group == group)
-		{
-			return &(i->receivers);
-		}
+	// receivers of all the ip groups mapping to this mac address
+	EmpowerMulticastMacGroup *mac = mac_groups.get_pointer(group);
+
+	if (mac) {
+		return &(mac->receivers);
 	}
 
-	click_chatter("%{element} :: %s :: IGMP group %s not found.",
-														  this,
-														  __func__, group.unparse().c_str());
+	if (_debug) {
+		click_chatter("%{element} :: %s :: IGMP group %s not found.",
+					  this,
+					  __func__, group.unparse().c_str());
+	}
 
 	return NULL;
+
 }
 
 bool EmpowerMulticastTable::leaveallgroups(EtherAddress sta)
 {
 
+	Vector<IPAddress> *groups = sta_groups.get_pointer(sta);
+
+	if (!groups) {
+		return true;
+	}
+
 	click_chatter("%{element} :: %s :: Station %s is about to leave all IGMP groups",
-										  this,
-										  __func__, sta.unparse().c_str());
-
-	Vector<EmpowerMulticastGroup>::iterator i;
-
-	for (i = multicastgroups.begin(); i != multicastgroups.end();)
-	{
-		Vector<EmpowerMulticastReceiver>::iterator a;
-		for (a = (*i).receivers.begin(); a != (*i).receivers.end(); a++)
-		{
-			if ((*a).sta == sta)
-			{
-				(*i).receivers.erase(a);
-				click_chatter("%{element} :: %s :: Station %s removed from  IGMP group %d.%d.%d.%d",
-									this, __func__, sta.unparse().c_str(),
-									(*i).group.data()[0], (*i).group.data()[1],
-									(*i).group.data()[2], (*i).group.data()[3]);
+				  this,
+				  __func__, sta.unparse().c_str());
 
-				break;
-			}
+	for (int j = 0; j < groups->size(); j++) {
+
+		EmpowerMulticastGroup *i = multicastgroups.get_pointer((*groups)[j]);
+
+		if (!i || !remove_receiver(i->receivers, i->receivers_index, sta)) {
+			continue;
 		}
 
+		leave_mac_group(i->mac_group, sta);
+
+		click_chatter("%{element} :: %s :: Station %s removed from  IGMP group %d.%d.%d.%d",
+					  this, __func__, sta.unparse().c_str(),
+					  i->group.data()[0], i->group.data()[1],
+					  i->group.data()[2], i->group.data()[3]);
+
 		// The group is deleted if no more receivers belong to it
-		if ((*i).receivers.begin() == (*i).receivers.end())
-		{
-			i = multicastgroups.erase(i);
-			click_chatter("%{element} :: %s :: IGMP group %d.%d.%d.%d is empty. It is about to be deleted",
-													this, __func__, (*i).group.data()[0], (*i).group.data()[1],
-													(*i).group.data()[2], (*i).group.data()[3]);
+		if (i->receivers.empty()) {
+			delgroup(i);
 		}
-		else
-			i++;
+
 	}
 
+	sta_groups.erase(sta);
+
 	return true;
+
 }
 
 enum {
@@ -218,15 +333,14 @@ String EmpowerMulticastTable::read_handler(Element *e, void *thunk) {
 		return String(td->_debug) + "\n";
 	case H_MULTICAST_TABLE: {
 		StringAccum sa;
-		Vector<EmpowerMulticastGroup>::iterator i;
-		for (i = td->multicastgroups.begin(); i != td->multicastgroups.end(); i++) {
-			sa << i->group.unparse() << " " <<  i->mac_group.unparse();
+		for (MGIter i = td->multicastgroups.begin(); i.live(); i++) {
+			sa << i.value().group.unparse() << " " <<  i.value().mac_group.unparse();
 
 			Vector<EmpowerMulticastReceiver>::iterator a;
 			sa << " receivers [ ";
-			for (a = (*i).receivers.begin(); a != (*i).receivers.end(); a++) {
+			for (a = i.value().receivers.begin(); a != i.value().receivers.end(); a++) {
 				sa << (*a).sta.unparse();
-				if (a != (*i).receivers.end())
+				if (a != i.value().receivers.end())
 					sa << ", ";
 			}
 			sa << "]\n";
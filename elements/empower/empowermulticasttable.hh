@@ -4,6 +4,8 @@
 #include <click/element.hh>
 #include <click/config.h>
 #include <click/etheraddress.hh>
+#include <click/ipaddress.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 
 /*
@@ -17,6 +19,18 @@ Handle IGMP packets
 
 =d
 
+Groups are indexed by IP address and by the derived MAC address, the
+receivers of a group are indexed by station, and every station keeps
+the list of groups it joined. Joining, leaving and removing a station
+from all its groups do not depend on the size of the table.
+
+Several IP groups map to the same MAC address. The receivers of a MAC
+address are the stations that joined any of its IP groups, each listed
+once; this is what EmpowerWifiEncap duplicates DMS frames to.
+
+The groups and their receivers are carried over a hotswap, so DMS frames
+keep reaching the stations without waiting for their next IGMP report.
+
 Keyword arguments are:
 
 =over 8
@@ -46,6 +60,7 @@ public:
 	const char *port_count() const { return PORTS_0_0; }
 
 	int configure(Vector<String> &, ErrorHandler *);
+	void take_state(Element *, ErrorHandler *);
 	void add_handlers();
 
 	struct EmpowerMulticastReceiver {
@@ -58,9 +73,24 @@ public:
 		IPAddress group; // group address
 		EtherAddress mac_group;
 		Vector<struct EmpowerMulticastReceiver> receivers;
+		HashTable<EtherAddress, int> receivers_index; // sta -> position in receivers
 	};
 
-	Vector<struct EmpowerMulticastGroup> multicastgroups;
+	struct EmpowerMulticastMacGroup {
+		Vector<IPAddress> groups; // ip groups mapping to this mac address
+		Vector<struct EmpowerMulticastReceiver> receivers; // union of their receivers
+		HashTable<EtherAddress, int> receivers_index; // sta -> position in receivers
+		HashTable<EtherAddress, int> receivers_joined; // sta -> groups joined
+	};
+
+	typedef HashTable<IPAddress, EmpowerMulticastGroup> MulticastGroups;
+	typedef MulticastGroups::iterator MGIter;
+
+	// groups by ip address, groups by mac address (several ip groups
+	// map to the same mac address) and groups joined by each station
+	MulticastGroups multicastgroups;
+	HashTable<EtherAddress, EmpowerMulticastMacGroup> mac_groups;
+	HashTable<EtherAddress, Vector<IPAddress> > sta_groups;
 
 	EtherAddress ip_mcast_addr_to_mac(IPAddress ip) {
 
@@ -89,6 +119,11 @@ private:
 
 	bool _debug;
 
+	void delgroup(EmpowerMulticastGroup *);
+	bool remove_receiver(Vector<EmpowerMulticastReceiver> &, HashTable<EtherAddress, int> &, EtherAddress);
+	void join_mac_group(EtherAddress, EtherAddress);
+	void leave_mac_group(EtherAddress, EtherAddress);
+
 	// Read/Write handlers
 	static String read_handler(Element *e, void *user_data);
 	static int write_handler(const String &, Element *, void *, ErrorHandler *);
@@ -214,6 +214,8 @@ void EmpowerOpenAuthResponder::send_auth_response(EtherAddress dst, uint16_t seq
 	ess->_assoc_id = 0;
 	ess->_ssid = (const char*)'\0';
 
+	_el->index_lvap(ess);
+
 	EtherAddress bssid = ess->_lvap_bssid;
 
 	if (_debug) {
@@ -100,6 +100,13 @@ enum empower_packet_types {
 	EMPOWER_PT_VAP_STATUS_REQ = 0x54,			// ac -> wtp
 	EMPOWER_PT_PORT_STATUS_REQ = 0x55,			// ac -> wtp
 
+	// Airtime fairness
+	EMPOWER_PT_SET_AIRTIME_QUANTUM = 0x56,		// ac -> wtp
+
+	// Per-LVAP queue management
+	EMPOWER_PT_LVAP_AQM_STATS_REQUEST = 0x57,	// ac -> wtp
+	EMPOWER_PT_LVAP_AQM_STATS_RESPONSE = 0x58,	// wtp -> ac
+
 };
 
 /* header format, common to all messages */
@@ -410,10 +417,11 @@ public:
     void set_counters_id(uint32_t counters_id) { _counters_id = htonl(counters_id); }
 } CLICK_SIZE_PACKED_ATTRIBUTE;
 
-/* counters entry format */
+/* counters entry format, one per non-empty histogram bin. The size is
+ * the mean size of the frames counted in the bin. */
 struct counters_entry {
   private:
-    uint16_t _size;		/* Frame size in bytes (int) */
+    uint16_t _size;		/* Mean frame size in bytes (int) */
     uint32_t _count; 	/* Number of frames (int) */
   public:
     void set_size(uint16_t size)   { _size = htons(size); }
@@ -442,11 +450,11 @@ public:
     void set_counters_id(uint32_t counters_id) { _counters_id = htonl(counters_id); }
 } CLICK_SIZE_PACKED_ATTRIBUTE;
 
-/* counters entry format */
+/* counters entry format, the size is the mean size of the bin as above */
 struct wtp_counters_entry {
   private:
     uint8_t  _sta[6];	/* EtherAddress */
-    uint16_t _size;		/* Frame size in bytes (int) */
+    uint16_t _size;		/* Mean frame size in bytes (int) */
     uint32_t _count; 	/* Number of frames (int) */
   public:
     void set_sta(EtherAddress sta) { memcpy(_sta, sta.data(), 6); }
@@ -571,8 +579,7 @@ private:
     uint8_t  _ur_mcast_count;	/* Number of unsolicited replies (int) */
     uint8_t  _nb_mcs;			/* Number of rate entries (int) */
     uint8_t  _nb_ht_mcs;		/* Number of HT rate entries (int) */
-    uint8_t  *mcs[];			/* Rate entries in units of 500kbps or MCS index */
-    uint8_t  *ht_mcs[];			/* HT Rate entries as MCS index */
+    uint8_t  _mcs[];			/* Rate entries in units of 500kbps or MCS index followed by HT rate entries as MCS index */
 public:
     bool flag(int f)         			{ return ntohs(_flags) & f;  }
     uint8_t band()           			{ return _band; }
@@ -600,8 +607,7 @@ private:
     uint8_t  _ur_mcast_count;	/* Number of unsolicited replies (int) */
     uint8_t  _nb_mcs;			/* Number of rate entries (int) */
     uint8_t  _nb_ht_mcs;		/* Number of HT rate entries (int) */
-    uint8_t  *mcs[];			/* Rate entries in units of 500kbps or MCS index */
-    uint8_t  *ht_mcs[];			/* HT Rate entries as MCS index */
+    uint8_t  _mcs[];			/* Rate entries in units of 500kbps or MCS index followed by HT rate entries as MCS index */
 public:
     void set_band(uint8_t band)                     	{ _band = band; }
     void set_channel(uint8_t channel)               	{ _channel = channel; }
@@ -730,10 +736,12 @@ private:
     uint32_t _trigger_id; 	/* Module id (int) */
     uint8_t _wtp[6];			/* EtherAddress */
     uint16_t _nb_entries;		/* Number of frames (int) */
+    uint32_t _nb_dropped;		/* Frames matched but not reported in this period, set in the first chunk only (int) */
 public:
     void set_trigger_id(uint32_t trigger_id) { _trigger_id = htonl(trigger_id); }
     void set_wtp(EtherAddress wtp)           { memcpy(_wtp, wtp.data(), 6); }
     void set_nb_frames(uint16_t nb_entries)  { _nb_entries = htons(nb_entries); }
+    void set_nb_dropped(uint32_t nb_dropped) { _nb_dropped = htonl(nb_dropped); }
 } CLICK_SIZE_PACKED_ATTRIBUTE;
 
 /* summary entry format */
@@ -914,5 +922,51 @@ struct empower_del_mcast_receiver : public empower_header {
 	EtherAddress hwaddr()		{ return EtherAddress(_hwaddr); }
 } CLICK_SIZE_PACKED_ATTRIBUTE;
 
+/* set airtime quantum packet format */
+struct empower_set_airtime_quantum : public empower_header {
+  private:
+	uint8_t  _sta[6]; 			/* EtherAddress */
+	uint32_t _quantum;			/* Airtime per round in usec, 0 for the default (int) */
+  public:
+	EtherAddress sta()			{ return EtherAddress(_sta); }
+	uint32_t     quantum()		{ return ntohl(_quantum); }
+} CLICK_SIZE_PACKED_ATTRIBUTE;
+
+/* lvap aqm stats request packet format */
+struct empower_lvap_aqm_stats_request : public empower_header {
+  private:
+	uint32_t _aqm_stats_id;		/* Module id (int) */
+	uint8_t  _sta[6]; 			/* EtherAddress */
+  public:
+	uint32_t     aqm_stats_id()	{ return ntohl(_aqm_stats_id); }
+	EtherAddress sta()			{ return EtherAddress(_sta); }
+} CLICK_SIZE_PACKED_ATTRIBUTE;
+
+/* lvap aqm stats response packet format */
+struct empower_lvap_aqm_stats_response : public empower_header {
+  private:
+	uint32_t _aqm_stats_id;		/* Module id (int) */
+	uint8_t  _wtp[6];			/* EtherAddress */
+	uint8_t  _sta[6]; 			/* EtherAddress */
+	uint32_t _length;			/* Frames queued (int) */
+	uint32_t _packets;			/* Frames dequeued (int) */
+	uint32_t _drops;			/* Frames dropped, queue full (int) */
+	uint32_t _codel_drops;		/* Frames dropped by CoDel (int) */
+	uint32_t _sojourn_p50;		/* Sojourn time percentiles in usec (int) */
+	uint32_t _sojourn_p90;
+	uint32_t _sojourn_p99;
+  public:
+	void set_aqm_stats_id(uint32_t aqm_stats_id)	{ _aqm_stats_id = htonl(aqm_stats_id); }
+	void set_wtp(EtherAddress wtp)					{ memcpy(_wtp, wtp.data(), 6); }
+	void set_sta(EtherAddress sta)					{ memcpy(_sta, sta.data(), 6); }
+	void set_queue_length(uint32_t length)			{ _length = htonl(length); }
+	void set_packets(uint32_t packets)				{ _packets = htonl(packets); }
+	void set_drops(uint32_t drops)					{ _drops = htonl(drops); }
+	void set_codel_drops(uint32_t codel_drops)		{ _codel_drops = htonl(codel_drops); }
+	void set_sojourn_p50(uint32_t usec)				{ _sojourn_p50 = htonl(usec); }
+	void set_sojourn_p90(uint32_t usec)				{ _sojourn_p90 = htonl(usec); }
+	void set_sojourn_p99(uint32_t usec)				{ _sojourn_p99 = htonl(usec); }
+} CLICK_SIZE_PACKED_ATTRIBUTE;
+
 CLICK_ENDDECLS
 #endif /* CLICK_EMPOWERPACKET_HH */
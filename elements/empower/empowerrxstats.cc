@@ -43,62 +43,26 @@ void send_summary_trigger_callback(Timer *timer, void *data) {
 	timer->schedule_after_msec(summary->_period);
 }
 
-void send_rssi_trigger_callback(Timer *timer, void *data) {
-	// process triggers
-	RssiTrigger *rssi = (RssiTrigger *) data;
-	rssi->_ers->lock.acquire_write();
-	for (NTIter iter = rssi->_ers->stas.begin(); iter.live(); iter++) {
-		DstInfo *nfo = &iter.value();
-		// not matching the address
-		if (nfo->_eth != rssi->_eth) {
-			continue;
-		}
-		// check if condition matches
-		if (rssi->matches(nfo) && !rssi->_dispatched) {
-			rssi->_el->send_rssi_trigger(rssi->_trigger_id, nfo->_iface_id, nfo->_sma_rssi->avg());
-			rssi->_dispatched = true;
-		} else if (!rssi->matches(nfo) && rssi->_dispatched) {
-			rssi->_dispatched = false;
-		}
-	}
-	rssi->_ers->lock.release_write();
-	// re-schedule the timer
-	timer->schedule_after_msec(rssi->_period);
-}
-
-void send_busyness_trigger_callback(Timer *timer, void *data) {
-	// process triggers
-	BusynessTrigger *busyness = (BusynessTrigger *) data;
-	busyness->_ers->lock.acquire_write();
-	for (CBFTIter iter = busyness->_ers->busyness.begin(); iter.live(); iter++) {
-		BusynessInfo *nfo = &iter.value();
-		// not matching the address
-		if (nfo->_iface_id != busyness->_iface_id) {
-			continue;
-		}
-		// check if condition matches
-		if (busyness->matches(nfo) && !busyness->_dispatched) {
-			busyness->_el->send_busyness_trigger(busyness->_trigger_id, nfo->_iface_id, nfo->_sma_busyness->avg());
-			busyness->_dispatched = true;
-		} else if (!busyness->matches(nfo) && busyness->_dispatched) {
-			busyness->_dispatched = false;
-		}
-	}
-	busyness->_ers->lock.release_write();
-	// re-schedule the timer
-	timer->schedule_after_msec(busyness->_period);
-}
-
 EmpowerRXStats::EmpowerRXStats() :
-		_el(0), _timer(this), _signal_offset(0), _period(500),
-		_sma_period(13), _max_silent_window_count(10), _debug(false) {
-
+		_current(0), _epoch(0), _el(0), _timer(this), _signal_offset(0),
+		_period(500), _sma_period(13), _max_silent_window_count(10),
+		_summary_max_frames(4096), _summary_sampling(1), _summary_reservoir(false),
+		_debug(false) {
+	_reset = 0;
 }
 
 EmpowerRXStats::~EmpowerRXStats() {
+	for (int i = 0; i < _shards.size(); i++) {
+		delete _shards[i];
+	}
 }
 
 int EmpowerRXStats::initialize(ErrorHandler *) {
+	// one shard for each interface
+	int nb_shards = (_el && _el->num_ifaces() > 0) ? _el->num_ifaces() : 1;
+	for (int i = 0; i < nb_shards; i++) {
+		_shards.push_back(new RXStatsShard());
+	}
 	_timer.initialize(this);
 	_timer.schedule_now();
 	return 0;
@@ -111,52 +75,127 @@ int EmpowerRXStats::configure(Vector<String> &conf, ErrorHandler *errh) {
 			.read("SMA_PERIOD", _sma_period)
 			.read("SIGNAL_OFFSET", _signal_offset)
 			.read("PERIOD", _period)
+			.read("SUMMARY_MAX_FRAMES", _summary_max_frames)
+			.read("SUMMARY_SAMPLING", _summary_sampling)
+			.read("SUMMARY_RESERVOIR", _summary_reservoir)
 			.read("DEBUG", _debug)
 			.complete();
 
+	if (ret < 0)
+		return ret;
+
+	if (_summary_max_frames <= 0)
+		return errh->error("SUMMARY_MAX_FRAMES must be positive");
+
+	if (_summary_sampling == 0)
+		return errh->error("SUMMARY_SAMPLING must be positive");
+
 	return ret;
 
 }
 
+void EmpowerRXStats::take_state(Element *e, ErrorHandler *) {
+
+	EmpowerRXStats *q = (EmpowerRXStats *) e->cast("EmpowerRXStats");
+
+	if (!q) {
+		return;
+	}
+
+	_aps.swap(q->_aps);
+	_stas.swap(q->_stas);
+	_busyness.swap(q->_busyness);
+
+	_rssi_triggers.swap(q->_rssi_triggers);
+	_rssi_index.swap(q->_rssi_index);
+	_busyness_triggers.swap(q->_busyness_triggers);
+	_busyness_index.swap(q->_busyness_index);
+	_summary_triggers.swap(q->_summary_triggers);
+
+	// triggers point back to the elements they were added to
+	for (RTIter it = _rssi_triggers.begin(); it != _rssi_triggers.end(); it++) {
+		(*it)->_el = _el;
+		(*it)->_ers = this;
+	}
+
+	for (BTIter it = _busyness_triggers.begin(); it != _busyness_triggers.end(); it++) {
+		(*it)->_el = _el;
+		(*it)->_ers = this;
+	}
+
+	// timers cannot move between routers, give summaries new ones
+	for (DTIter it = _summary_triggers.begin(); it != _summary_triggers.end(); it++) {
+		SummaryTrigger *summary = *it;
+		summary->_el = _el;
+		summary->_ers = this;
+		delete summary->_trigger_timer;
+		summary->_trigger_timer = new Timer(&send_summary_trigger_callback, (void *) summary);
+		summary->_trigger_timer->initialize(this);
+		summary->_trigger_timer->schedule_after_msec(summary->_period);
+	}
+
+	// readers see the old statistics until the first period ends
+	_epoch = q->_epoch;
+	publish_snapshot();
+
+}
+
 void EmpowerRXStats::run_timer(Timer *) {
-	// process stations
+	// the controller may add or remove triggers meanwhile
 	lock.acquire_write();
-	for (NTIter iter = stas.begin(); iter.live();) {
+	// reset requested from the handler
+	if (_reset.swap(0)) {
+		_stas.clear();
+		_aps.clear();
+	}
+	// collect the samples received since the last period
+	for (int i = 0; i < _shards.size(); i++) {
+		merge_shard(_shards[i]);
+	}
+	// process stations
+	for (NTIter iter = _stas.begin(); iter.live();) {
 		// Update stats
 		DstInfo *nfo = &iter.value();
 		nfo->update();
+		if (_rssi_index.size()) {
+			evaluate_rssi_triggers(nfo);
+		}
 		// Delete stale entries
 		if (nfo->_silent_window_count > _max_silent_window_count) {
-			iter = stas.erase(iter);
+			iter = _stas.erase(iter);
 		} else {
 			++iter;
 		}
 	}
 	// process access points
-	for (NTIter iter = aps.begin(); iter.live();) {
+	for (NTIter iter = _aps.begin(); iter.live();) {
 		// Update aps
 		DstInfo *nfo = &iter.value();
 		nfo->update();
 		// Delete stale entries
 		if (nfo->_silent_window_count > _max_silent_window_count) {
-			iter = aps.erase(iter);
+			iter = _aps.erase(iter);
 		} else {
 			++iter;
 		}
 	}
 	// process busyness
-	for (CBFTIter iter = busyness.begin(); iter.live();) {
+	for (CBFTIter iter = _busyness.begin(); iter.live();) {
 		// Update busyness
 		BusynessInfo *nfo = &iter.value();
 		nfo->update();
+		if (_busyness_index.size()) {
+			evaluate_busyness_triggers(nfo);
+		}
 		// Delete stale entries
 		if (nfo->_silent_window_count > _max_silent_window_count) {
-			iter = busyness.erase(iter);
+			iter = _busyness.erase(iter);
 		} else {
 			++iter;
 		}
 	}
 	lock.release_write();
+	publish_snapshot();
 	// rescheduler
 	_timer.schedule_after_msec(_period);
 }
@@ -241,10 +280,33 @@ EmpowerRXStats::simple_action(Packet *p) {
 
 	uint8_t iface_id = PAINT_ANNO(p);
 
-	lock.acquire_write();
+	RXStatsShard *shard = _shards[iface_id % _shards.size()];
 
-	update_neighbor(ta, station, iface_id, rssi);
-	update_channel_busyness_time(iface_id, p->length(), ceh->rate);
+	shard->_lock.acquire();
+
+	NeighborSamples *samples = station ? &shard->_stas : &shard->_aps;
+	NeighborSample *ns = samples->get_pointer(ta);
+	if (!ns) {
+		samples->set(ta, NeighborSample());
+		ns = samples->get_pointer(ta);
+		ns->_iface_id = iface_id;
+	}
+	ns->add_sample(rssi);
+
+	BusynessSample *bs = shard->_busyness.get_pointer(iface_id);
+	if (!bs) {
+		shard->_busyness.set(iface_id, BusynessSample());
+		bs = shard->_busyness.get_pointer(iface_id);
+	}
+	bs->add_sample(p->length(), ceh->rate);
+
+	shard->_lock.release();
+
+	if (!_summary_triggers.size()) {
+		return p;
+	}
+
+	lock.acquire_write();
 
 	// check if frame meta-data should be saved
 	for (DTIter qi = _summary_triggers.begin(); qi != _summary_triggers.end(); qi++) {
@@ -253,7 +315,7 @@ EmpowerRXStats::simple_action(Packet *p) {
 		}
 		if ((*qi)->_eth == ta || (*qi)->_eth.is_broadcast()) {
 			Frame frame = Frame(ra, ta, ceh->tsft, ceh->flags, w->i_seq, rssi, ceh->rate, type, subtype, p->length(), retry, station, iface_id);
-			(*qi)->_frames.push_back(frame);
+			(*qi)->add_frame(frame);
 		}
 	}
 
@@ -263,155 +325,394 @@ EmpowerRXStats::simple_action(Packet *p) {
 
 }
 
-void EmpowerRXStats::update_channel_busyness_time(uint8_t iface_id, uint32_t len, uint8_t rate) {
+void EmpowerRXStats::merge_shard(RXStatsShard *shard) {
+
+	NeighborSamples stas_samples;
+	NeighborSamples aps_samples;
+	BusynessSamples busyness_samples;
+
+	// take the samples out, the rx path starts over with empty tables
+	shard->_lock.acquire();
+	stas_samples.swap(shard->_stas);
+	aps_samples.swap(shard->_aps);
+	busyness_samples.swap(shard->_busyness);
+	shard->_lock.release();
+
+	for (NSIter iter = stas_samples.begin(); iter.live(); iter++) {
+		NeighborSample *ns = &iter.value();
+		DstInfo *nfo = get_neighbor(_stas, iter.key(), ns->_iface_id);
+		nfo->add_samples(ns->_packets, ns->_accum_rssi, ns->_squares_rssi, ns->_last_received);
+	}
+
+	for (NSIter iter = aps_samples.begin(); iter.live(); iter++) {
+		NeighborSample *ns = &iter.value();
+		DstInfo *nfo = get_neighbor(_aps, iter.key(), ns->_iface_id);
+		nfo->add_samples(ns->_packets, ns->_accum_rssi, ns->_squares_rssi, ns->_last_received);
+	}
+
+	for (BSIter iter = busyness_samples.begin(); iter.live(); iter++) {
+		BusynessInfo *nfo = get_busyness(iter.key());
+		nfo->add_samples(iter.value()._packets, iter.value()._accum_busyness);
+	}
+
+}
+
+void EmpowerRXStats::evaluate_rssi_triggers(DstInfo *nfo) {
+	RssiTriggersList *triggers = _rssi_index.get_pointer(nfo->_eth);
+	if (!triggers) {
+		return;
+	}
+	int rssi = nfo->_sma_rssi->avg();
+	for (RTIter qi = triggers->begin(); qi != triggers->end(); qi++) {
+		bool matches = (*qi)->matches(rssi);
+		bool dispatched = nfo->dispatched((*qi)->_trigger_id);
+		if (matches && !dispatched) {
+			_el->send_rssi_trigger((*qi)->_trigger_id, nfo->_iface_id, rssi);
+			nfo->set_dispatched((*qi)->_trigger_id, true);
+		} else if (!matches && dispatched) {
+			nfo->set_dispatched((*qi)->_trigger_id, false);
+		}
+	}
+}
+
+void EmpowerRXStats::evaluate_busyness_triggers(BusynessInfo *nfo) {
+	BusynessTriggersList *triggers = _busyness_index.get_pointer(nfo->_iface_id);
+	if (!triggers) {
+		return;
+	}
+	int busyness = nfo->_sma_busyness->avg();
+	for (BTIter qi = triggers->begin(); qi != triggers->end(); qi++) {
+		bool matches = (*qi)->matches(busyness);
+		bool dispatched = nfo->dispatched((*qi)->_trigger_id);
+		if (matches && !dispatched) {
+			_el->send_busyness_trigger((*qi)->_trigger_id, nfo->_iface_id, busyness);
+			nfo->set_dispatched((*qi)->_trigger_id, true);
+		} else if (!matches && dispatched) {
+			nfo->set_dispatched((*qi)->_trigger_id, false);
+		}
+	}
+}
+
+void EmpowerRXStats::fill_neighbors(NeighborStatsTable &out, NeighborTable &table) {
+
+	int nb_ifaces = 0;
+	for (NTIter iter = table.begin(); iter.live(); iter++) {
+		if (iter.value()._iface_id >= nb_ifaces) {
+			nb_ifaces = iter.value()._iface_id + 1;
+		}
+	}
+
+	// group the entries by interface (counting sort)
+	out._first.resize(nb_ifaces + 1, 0);
+	for (NTIter iter = table.begin(); iter.live(); iter++) {
+		out._first[iter.value()._iface_id + 1]++;
+	}
+	for (int i = 0; i < nb_ifaces; i++) {
+		out._first[i + 1] += out._first[i];
+	}
+
+	out._stats.resize(table.size(), NeighborStats());
+	out._wire_len = sizeof(cqm_entry);
+	out._wire.resize(table.size() * sizeof(cqm_entry), 0);
+	_cursor.resize(nb_ifaces, 0);
+	for (int i = 0; i < nb_ifaces; i++) {
+		_cursor[i] = out._first[i];
+	}
+
+	for (NTIter iter = table.begin(); iter.live(); iter++) {
+		DstInfo *nfo = &iter.value();
+		int pos = _cursor[nfo->_iface_id]++;
+		NeighborStats &ns = out._stats[pos];
+		ns._eth = nfo->_eth;
+		ns._sender_type = nfo->_sender_type;
+		ns._iface_id = nfo->_iface_id;
+		ns._last_rssi = nfo->_last_rssi;
+		ns._last_std = nfo->_last_std;
+		ns._last_packets = nfo->_last_packets;
+		ns._hist_packets = nfo->_hist_packets;
+		ns._mov_rssi = nfo->_sma_rssi->avg();
+		ns._silent_window_count = nfo->_silent_window_count;
+		ns._last_received = nfo->_last_received;
+		cqm_entry *entry = (cqm_entry *) &out._wire[pos * sizeof(cqm_entry)];
+		entry->set_sta(ns._eth);
+		entry->set_last_rssi_avg(ns._last_rssi);
+		entry->set_last_rssi_std(ns._last_std);
+		entry->set_last_packets(ns._last_packets);
+		entry->set_hist_packets(ns._hist_packets);
+		entry->set_mov_rssi(ns._mov_rssi);
+	}
+
+}
+
+void EmpowerRXStats::publish_snapshot() {
+
+	// pick a snapshot that is neither published nor pinned by a reader
+	RXStatsSnapshot *next = 0;
+	for (int i = 0; i < 3; i++) {
+		if (&_snapshots[i] != _current && _snapshots[i]._refs == 0) {
+			next = &_snapshots[i];
+			break;
+		}
+	}
+
+	if (!next) {
+		if (_debug) {
+			click_chatter("%{element} :: %s :: all snapshots in use, skipping epoch %u",
+						  this,
+						  __func__,
+						  _epoch + 1);
+		}
+		return;
+	}
+
+	next->clear();
+	fill_neighbors(next->_stas, _stas);
+	fill_neighbors(next->_aps, _aps);
+
+	BusynessStats unused;
+	unused._iface_id = -1;
+	for (CBFTIter iter = _busyness.begin(); iter.live(); iter++) {
+		BusynessInfo *nfo = &iter.value();
+		if (nfo->_iface_id < 0) {
+			continue;
+		}
+		if (nfo->_iface_id >= next->_busyness.size()) {
+			next->_busyness.resize(nfo->_iface_id + 1, unused);
+		}
+		BusynessStats &bs = next->_busyness[nfo->_iface_id];
+		bs._iface_id = nfo->_iface_id;
+		bs._last_busyness = nfo->_last_busyness;
+		bs._sma_busyness = nfo->_sma_busyness->avg();
+		bs._last_packets = nfo->_last_packets;
+		bs._silent_window_count = nfo->_silent_window_count;
+		bs._last_updated = nfo->_last_updated;
+	}
+
+	next->_epoch = ++_epoch;
+	next->_taken = Timestamp::now();
+
+	// make the content visible before the pointer
+	click_fence();
+	_current = next;
+
+}
+
+RXStatsSnapshot *EmpowerRXStats::acquire_snapshot() {
+	for (;;) {
+		RXStatsSnapshot *snapshot = _current;
+		if (!snapshot) {
+			return 0;
+		}
+		snapshot->_refs++;
+		click_fence();
+		// still published: the writer will not touch it until released
+		if (snapshot == _current) {
+			return snapshot;
+		}
+		snapshot->_refs--;
+	}
+}
+
+void EmpowerRXStats::release_snapshot(RXStatsSnapshot *snapshot) {
+	snapshot->_refs--;
+}
+
+BusynessInfo *EmpowerRXStats::get_busyness(int iface_id) {
+
+	BusynessInfo *nfo = _busyness.get_pointer(iface_id);
 
-	// Update channel busyness time
-	BusynessInfo *nfo;
-	nfo = busyness.get_pointer(iface_id);
 	if (!nfo) {
-		busyness[iface_id] = BusynessInfo();
-		nfo = busyness.get_pointer(iface_id);
+		_busyness[iface_id] = BusynessInfo();
+		nfo = _busyness.get_pointer(iface_id);
 		nfo->_iface_id = iface_id;
 		nfo->_sma_busyness = new SMA(7);
 	}
 
-	// Add sample
-	nfo->add_sample(len, rate);
+	return nfo;
 
 }
 
-void EmpowerRXStats::update_neighbor(EtherAddress ta, bool station, uint8_t iface_id, uint8_t rssi) {
-
-	DstInfo *nfo;
+DstInfo *EmpowerRXStats::get_neighbor(NeighborTable &table, EtherAddress ta, int iface_id) {
 
-	if (station) {
-		nfo = stas.get_pointer(ta);
-	} else {
-		nfo = aps.get_pointer(ta);
-	}
+	DstInfo *nfo = table.get_pointer(ta);
 
 	if (!nfo) {
-		if (station) {
-			stas[ta] = DstInfo();
-			nfo = stas.get_pointer(ta);
-			nfo->_sma_rssi = new SMA(_sma_period);
-			nfo->_iface_id = iface_id;
-			nfo->_eth = ta;
-		} else {
-			aps[ta] = DstInfo();
-			nfo = aps.get_pointer(ta);
-			nfo->_sma_rssi = new SMA(_sma_period);
-			nfo->_iface_id = iface_id;
-			nfo->_eth = ta;
-		}
+		table[ta] = DstInfo();
+		nfo = table.get_pointer(ta);
+		nfo->_sma_rssi = new SMA(_sma_period);
+		nfo->_iface_id = iface_id;
+		nfo->_eth = ta;
 	}
 
-	// Add sample
-	nfo->add_sample(rssi);
+	return nfo;
 
 }
 
 void EmpowerRXStats::add_busyness_trigger(int iface_id, uint32_t trigger_id, empower_trigger_relation rel, int val, uint16_t period) {
-    BusynessTrigger * busyness = new BusynessTrigger(iface_id, trigger_id, rel, val, false, period, _el, this);
-    for (BTIter qi = _busyness_triggers.begin(); qi != _busyness_triggers.end(); qi++) {
-        if (*busyness== **qi) {
-            click_chatter("%{element} :: %s :: trigger already defined (%s), setting sent to false",
-                          this,
-                          __func__,
-                          busyness->unparse().c_str());
-            (*qi)->_dispatched = false;
-            return;
-        }
-    }
-    busyness->_trigger_timer->assign(&send_busyness_trigger_callback, (void *) busyness);
-    busyness->_trigger_timer->initialize(this);
-    busyness->_trigger_timer->schedule_now();
-    _busyness_triggers.push_back(busyness);
+	BusynessTrigger * busyness = new BusynessTrigger(iface_id, trigger_id, rel, val, period, _el, this);
+	lock.acquire_write();
+	for (BTIter qi = _busyness_triggers.begin(); qi != _busyness_triggers.end(); qi++) {
+		if (*busyness == **qi) {
+			click_chatter("%{element} :: %s :: trigger already defined (%s), setting sent to false",
+						  this,
+						  __func__,
+						  busyness->unparse().c_str());
+			BusynessInfo *nfo = _busyness.get_pointer(iface_id);
+			if (nfo) {
+				nfo->set_dispatched((*qi)->_trigger_id, false);
+			}
+			delete busyness;
+			lock.release_write();
+			return;
+		}
+	}
+	_busyness_triggers.push_back(busyness);
+	_busyness_index[iface_id].push_back(busyness);
+	lock.release_write();
 }
 
 void EmpowerRXStats::del_busyness_trigger(uint32_t trigger_id) {
-    for (BTIter qi = _busyness_triggers.begin(); qi != _busyness_triggers.end(); qi++) {
-        if ((*qi)->_trigger_id == trigger_id) {
-            (*qi)->_trigger_timer->clear();
-            _busyness_triggers.erase(qi);
-            break;
-        }
-    }
+	lock.acquire_write();
+	for (BTIter qi = _busyness_triggers.begin(); qi != _busyness_triggers.end(); qi++) {
+		if ((*qi)->_trigger_id == trigger_id) {
+			BusynessTrigger *busyness = *qi;
+			BusynessTriggersList *triggers = _busyness_index.get_pointer(busyness->_iface_id);
+			if (triggers) {
+				for (BTIter ti = triggers->begin(); ti != triggers->end(); ti++) {
+					if (*ti == busyness) {
+						triggers->erase(ti);
+						break;
+					}
+				}
+				if (!triggers->size()) {
+					_busyness_index.erase(busyness->_iface_id);
+				}
+			}
+			BusynessInfo *nfo = _busyness.get_pointer(busyness->_iface_id);
+			if (nfo) {
+				nfo->set_dispatched(trigger_id, false);
+			}
+			_busyness_triggers.erase(qi);
+			delete busyness;
+			break;
+		}
+	}
+	lock.release_write();
 }
 
 void EmpowerRXStats::add_rssi_trigger(EtherAddress eth, uint32_t trigger_id, empower_trigger_relation rel, int val, uint16_t period) {
-	RssiTrigger * rssi = new RssiTrigger(eth, trigger_id, rel, val, false, period, _el, this);
+	RssiTrigger * rssi = new RssiTrigger(eth, trigger_id, rel, val, period, _el, this);
+	lock.acquire_write();
 	for (RTIter qi = _rssi_triggers.begin(); qi != _rssi_triggers.end(); qi++) {
-		if (*rssi== **qi) {
+		if (*rssi == **qi) {
 			click_chatter("%{element} :: %s :: trigger already defined (%s), setting sent to false",
 						  this,
 						  __func__,
 						  rssi->unparse().c_str());
-			(*qi)->_dispatched = false;
+			DstInfo *nfo = _stas.get_pointer(eth);
+			if (nfo) {
+				nfo->set_dispatched((*qi)->_trigger_id, false);
+			}
+			delete rssi;
+			lock.release_write();
 			return;
 		}
 	}
-	rssi->_trigger_timer->assign(&send_rssi_trigger_callback, (void *) rssi);
-	rssi->_trigger_timer->initialize(this);
-	rssi->_trigger_timer->schedule_now();
 	_rssi_triggers.push_back(rssi);
+	_rssi_index[eth].push_back(rssi);
+	lock.release_write();
 }
 
 void EmpowerRXStats::del_rssi_trigger(uint32_t trigger_id) {
+	lock.acquire_write();
 	for (RTIter qi = _rssi_triggers.begin(); qi != _rssi_triggers.end(); qi++) {
 		if ((*qi)->_trigger_id == trigger_id) {
-			(*qi)->_trigger_timer->clear();
+			RssiTrigger *rssi = *qi;
+			RssiTriggersList *triggers = _rssi_index.get_pointer(rssi->_eth);
+			if (triggers) {
+				for (RTIter ti = triggers->begin(); ti != triggers->end(); ti++) {
+					if (*ti == rssi) {
+						triggers->erase(ti);
+						break;
+					}
+				}
+				if (!triggers->size()) {
+					_rssi_index.erase(rssi->_eth);
+				}
+			}
+			DstInfo *nfo = _stas.get_pointer(rssi->_eth);
+			if (nfo) {
+				nfo->set_dispatched(trigger_id, false);
+			}
 			_rssi_triggers.erase(qi);
+			delete rssi;
 			break;
 		}
 	}
+	lock.release_write();
 }
 
 void EmpowerRXStats::clear_triggers() {
+	lock.acquire_write();
 	// clear busyness triggers
 	for (BTIter qi = _busyness_triggers.begin(); qi != _busyness_triggers.end(); qi++) {
-		(*qi)->_trigger_timer->clear();
+		delete *qi;
 	}
 	_busyness_triggers.clear();
+	_busyness_index.clear();
+	for (CBFTIter iter = _busyness.begin(); iter.live(); iter++) {
+		iter.value()._dispatched.clear();
+	}
 	// clear rssi triggers
 	for (RTIter qi = _rssi_triggers.begin(); qi != _rssi_triggers.end(); qi++) {
-		(*qi)->_trigger_timer->clear();
+		delete *qi;
 	}
 	_rssi_triggers.clear();
+	_rssi_index.clear();
+	for (NTIter iter = _stas.begin(); iter.live(); iter++) {
+		iter.value()._dispatched.clear();
+	}
 	// clear summary triggers
 	for (DTIter qi = _summary_triggers.begin(); qi != _summary_triggers.end(); qi++) {
 		(*qi)->_trigger_timer->clear();
 		delete *qi;
 	}
 	_summary_triggers.clear();
+	lock.release_write();
 }
 
 void EmpowerRXStats::add_summary_trigger(int iface, EtherAddress addr, uint32_t summary_id, int16_t limit, uint16_t period) {
-	SummaryTrigger * summary = new SummaryTrigger(iface, addr, summary_id, limit, period, _el, this);
+	SummaryTrigger * summary = new SummaryTrigger(iface, addr, summary_id, limit, period,
+			_summary_max_frames, _summary_sampling, _summary_reservoir, _el, this);
 	for (DTIter qi = _summary_triggers.begin(); qi != _summary_triggers.end(); qi++) {
 		if (*summary == **qi) {
 			click_chatter("%{element} :: %s :: summary already defined (%s), ignoring",
 						  this,
 						  __func__,
 						  summary->unparse().c_str());
+			delete summary;
 			return;
 		}
 	}
 	summary->_trigger_timer->assign(&send_summary_trigger_callback, (void *) summary);
 	summary->_trigger_timer->initialize(this);
 	summary->_trigger_timer->schedule_now();
+	lock.acquire_write();
 	_summary_triggers.push_back(summary);
+	lock.release_write();
 }
 
 void EmpowerRXStats::del_summary_trigger(uint32_t summary_id) {
+	lock.acquire_write();
 	for (DTIter qi = _summary_triggers.begin(); qi != _summary_triggers.end(); qi++) {
 		if ((*qi)->_trigger_id == summary_id) {
 			(*qi)->_trigger_timer->clear();
-			_summary_triggers.erase(qi);
 			delete *qi;
+			_summary_triggers.erase(qi);
 			break;
 		}
 	}
+	lock.release_write();
 }
 
 enum {
@@ -434,59 +735,86 @@ String EmpowerRXStats::read_handler(Element *e, void *thunk) {
 	switch ((uintptr_t) thunk) {
 	case H_RSSI_MATCHES: {
 		StringAccum sa;
-		for (RTIter qi = td->_rssi_triggers.begin(); qi != td->_rssi_triggers.end(); qi++) {
-			for (NTIter iter = td->stas.begin(); iter.live(); iter++) {
-				DstInfo *nfo = &iter.value();
-				if (!nfo)
-					continue;
-				if ((*qi)->matches(nfo)) {
+		RXStatsSnapshot *snapshot = td->acquire_snapshot();
+		if (!snapshot) {
+			return String();
+		}
+		const Vector<NeighborStats> &stas = snapshot->_stas._stats;
+		td->lock.acquire_read();
+		for (int i = 0; i < stas.size(); i++) {
+			RssiTriggersList *triggers = td->_rssi_index.get_pointer(stas[i]._eth);
+			if (!triggers) {
+				continue;
+			}
+			for (RTIter qi = triggers->begin(); qi != triggers->end(); qi++) {
+				if ((*qi)->matches(stas[i]._mov_rssi)) {
 					sa << (*qi)->unparse();
-					sa << " current " << nfo->_sma_rssi->avg();
+					sa << " current " << stas[i]._mov_rssi;
 					sa << "\n";
 				}
 			}
 		}
+		td->lock.release_read();
+		td->release_snapshot(snapshot);
 		return sa.take_string();
 	}
 	case H_BUSYNESS_TRIGGERS: {
 		StringAccum sa;
+		td->lock.acquire_read();
 		for (BTIter qi = td->_busyness_triggers.begin(); qi != td->_busyness_triggers.end(); qi++) {
 			sa << (*qi)->unparse() << "\n";
 		}
+		td->lock.release_read();
 		return sa.take_string();
 	}
 	case H_RSSI_TRIGGERS: {
 		StringAccum sa;
+		td->lock.acquire_read();
 		for (RTIter qi = td->_rssi_triggers.begin(); qi != td->_rssi_triggers.end(); qi++) {
 			sa << (*qi)->unparse() << "\n";
 		}
+		td->lock.release_read();
 		return sa.take_string();
 	}
 	case H_SUMMARY_TRIGGERS: {
 		StringAccum sa;
+		td->lock.acquire_read();
 		for (DTIter qi = td->_summary_triggers.begin(); qi != td->_summary_triggers.end(); qi++) {
 			sa << (*qi)->unparse() << "\n";
 		}
+		td->lock.release_read();
 		return sa.take_string();
 	}
 	case H_NEIGHBORS: {
 		StringAccum sa;
-		for (NTIter iter = td->stas.begin(); iter.live(); iter++) {
-			DstInfo *nfo = &iter.value();
-			sa << nfo->unparse();
+		RXStatsSnapshot *snapshot = td->acquire_snapshot();
+		if (!snapshot) {
+			return String();
+		}
+		Timestamp now = Timestamp::now();
+		for (int i = 0; i < snapshot->_stas._stats.size(); i++) {
+			sa << snapshot->_stas._stats[i].unparse(now);
 		}
-		for (NTIter iter = td->aps.begin(); iter.live(); iter++) {
-			DstInfo *nfo = &iter.value();
-			sa << nfo->unparse();
+		for (int i = 0; i < snapshot->_aps._stats.size(); i++) {
+			sa << snapshot->_aps._stats[i].unparse(now);
 		}
+		td->release_snapshot(snapshot);
 		return sa.take_string();
 	}
 	case H_BUSYNESS: {
 		StringAccum sa;
-		for (CBFTIter iter = td->busyness.begin(); iter.live(); iter++) {
-			BusynessInfo *nfo = &iter.value();
-			sa << nfo->unparse();
+		RXStatsSnapshot *snapshot = td->acquire_snapshot();
+		if (!snapshot) {
+			return String();
+		}
+		Timestamp now = Timestamp::now();
+		for (int i = 0; i < snapshot->_busyness.size(); i++) {
+			if (snapshot->_busyness[i]._iface_id < 0) {
+				continue;
+			}
+			sa << snapshot->_busyness[i].unparse(now);
 		}
+		td->release_snapshot(snapshot);
 		return sa.take_string();
 	}
 	case H_SIGNAL_OFFSET:
@@ -506,8 +834,8 @@ int EmpowerRXStats::write_handler(const String &in_s, Element *e, void *vparam,
 
 	switch ((intptr_t) vparam) {
 	case H_RESET: {
-		f->stas.clear();
-		f->aps.clear();
+		// applied by the timer, which owns the tables
+		f->_reset = 1;
 		break;
 	}
 	case H_SIGNAL_OFFSET: {
@@ -543,5 +871,5 @@ void EmpowerRXStats::add_handlers() {
 }
 
 EXPORT_ELEMENT(EmpowerRXStats)
-ELEMENT_REQUIRES(bitrate DstInfo BusynessInfo Trigger SummaryTrigger RssiTrigger BusynessTrigger)
+ELEMENT_REQUIRES(bitrate DstInfo BusynessInfo RXStatsShard RXStatsSnapshot Trigger SummaryTrigger RssiTrigger BusynessTrigger)
 CLICK_ENDDECLS
@@ -14,6 +14,8 @@
 #include "busyness_trigger.hh"
 #include "dstinfo.hh"
 #include "busynessinfo.hh"
+#include "rxstatsshard.hh"
+#include "rxstatssnapshot.hh"
 #include "empowerpacket.hh"
 CLICK_DECLS
 
@@ -28,6 +30,22 @@ CLICK_DECLS
 
  =d
 
+ Received frames are accounted in one shard per interface (the paint
+ annotation), which is merged into the neighbour and busyness tables
+ every PERIOD. Radios served by different threads thus never contend on
+ the shared lock; the tables lag the air by at most one period.
+
+ RSSI and busyness triggers are indexed by address and interface and are
+ evaluated once per period, right after the moving averages are updated.
+ Whether a trigger already fired is kept with the neighbour (or interface)
+ entry, so a trigger fires again only after its condition stopped holding.
+ Controller messages adding or removing triggers take the shared lock,
+ as does the evaluation.
+
+ At the end of every period the tables are published as an immutable
+ snapshot. Controller queries, triggers and read handlers only look at
+ the latest snapshot and never lock against the RX path.
+
  Keyword arguments are:
 
  =over 8
@@ -35,6 +53,21 @@ CLICK_DECLS
  =item EL
  An EmpowerLVAPManager element
 
+ =item PERIOD
+ Interval between statistics updates (in msec), default is 500
+
+ =item SUMMARY_MAX_FRAMES
+ Frames buffered by each summary trigger between two reports, default
+ is 4096. Frames beyond the cap replace older ones and are counted as
+ dropped in the next report.
+
+ =item SUMMARY_SAMPLING
+ Capture only one matching frame every N, default is 1 (all frames)
+
+ =item SUMMARY_RESERVOIR
+ When the buffer is full, keep a uniform random sample of the period
+ (reservoir sampling) instead of the most recent frames. Default is false.
+
  =item DEBUG
  Turn debug on/off
 
@@ -58,6 +91,9 @@ typedef SummaryTriggersList::iterator DTIter;
 typedef Vector<BusynessTrigger *> BusynessTriggersList;
 typedef BusynessTriggersList::iterator BTIter;
 
+typedef HashTable<EtherAddress, RssiTriggersList> RssiTriggersIndex;
+typedef HashTable<int, BusynessTriggersList> BusynessTriggersIndex;
+
 class EmpowerLVAPManager;
 
 class EmpowerRXStats: public Element {
@@ -72,6 +108,7 @@ public:
 
 	int initialize(ErrorHandler *);
 	int configure(Vector<String> &, ErrorHandler *);
+	void take_state(Element *, ErrorHandler *);
 	void run_timer(Timer *);
 
 	Packet *simple_action(Packet *);
@@ -89,19 +126,33 @@ public:
 
 	void clear_triggers();
 
-	ReadWriteLock lock;
+	RXStatsSnapshot *acquire_snapshot();
+	void release_snapshot(RXStatsSnapshot *);
 
-	NeighborTable aps;
-	NeighborTable stas;
-	ChannelBusynessFractionTable busyness;
+	ReadWriteLock lock; // protects the triggers and their dispatched state
 
 private:
 
+	NeighborTable _aps;
+	NeighborTable _stas;
+	ChannelBusynessFractionTable _busyness;
+
+	// a published snapshot, one pinned by a slow reader and one to refill
+	RXStatsSnapshot _snapshots[3];
+	RXStatsSnapshot * volatile _current;
+	uint32_t _epoch;
+	Vector<int> _cursor;
+	atomic_uint32_t _reset;
+
 	EmpowerLVAPManager *_el;
 	Timer _timer;
 
+	Vector<RXStatsShard *> _shards;
+
 	BusynessTriggersList _busyness_triggers;
 	RssiTriggersList _rssi_triggers;
+	BusynessTriggersIndex _busyness_index;
+	RssiTriggersIndex _rssi_index;
 	SummaryTriggersList _summary_triggers;
 
 	int _signal_offset;
@@ -109,13 +160,22 @@ private:
 	unsigned _sma_period;
 	unsigned _max_silent_window_count; // in number of windows
 
+	int _summary_max_frames;
+	uint32_t _summary_sampling;
+	bool _summary_reservoir;
+
 	bool _debug;
 
 	static int write_handler(const String &, Element *, void *, ErrorHandler *);
 	static String read_handler(Element *, void *);
 
-	void update_neighbor(EtherAddress, bool, uint8_t, uint8_t);
-	void update_channel_busyness_time(uint8_t, uint32_t, uint8_t);
+	void merge_shard(RXStatsShard *);
+	void publish_snapshot();
+	void evaluate_rssi_triggers(DstInfo *);
+	void evaluate_busyness_triggers(BusynessInfo *);
+	void fill_neighbors(NeighborStatsTable &, NeighborTable &);
+	DstInfo *get_neighbor(NeighborTable &, EtherAddress, int);
+	BusynessInfo *get_busyness(int);
 
 };
 
@@ -168,7 +168,7 @@ EmpowerWifiDecap::push(int, Packet *p) {
 		return;
 	}
 
-	TxPolicyInfo * txp = _el->get_txp(src);
+	TxPolicyInfo * txp = ess->_txp;
 
 	// frame must be encapsulated in another Ethernet frame
 	if (ess->_encap) {
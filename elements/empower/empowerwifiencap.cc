@@ -23,6 +23,7 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/straccum.hh>
 #include <clicknet/wifi.h>
 #include <click/packet_anno.hh>
 #include <clicknet/llc.h>
@@ -30,10 +31,12 @@
 #include <elements/wifi/transmissionpolicy.hh>
 #include <elements/wifi/minstrel.hh>
 #include "empowerlvapmanager.hh"
+#include "empowermulticasttable.hh"
 CLICK_DECLS
 
 EmpowerWifiEncap::EmpowerWifiEncap() :
-		_el(0), _debug(false) {
+		_el(0), _mtbl(0), _dms_fallback(DMS_FALLBACK_ALL), _debug(false),
+		_dms_receivers_frames(0), _dms_fallback_frames(0) {
 }
 
 EmpowerWifiEncap::~EmpowerWifiEncap() {
@@ -42,11 +45,30 @@ EmpowerWifiEncap::~EmpowerWifiEncap() {
 int EmpowerWifiEncap::configure(Vector<String> &conf,
 		ErrorHandler *errh) {
 
-	return Args(conf, this, errh)
+	String dms_fallback = "ALL";
+
+	int res = Args(conf, this, errh)
 			.read_m("EL", ElementCastArg("EmpowerLVAPManager"), _el)
+			.read("MTBL", ElementCastArg("EmpowerMulticastTable"), _mtbl)
+			.read("DMS_FALLBACK", WordArg(), dms_fallback)
 			.read("DEBUG", _debug)
 			.complete();
 
+	if (res < 0)
+		return res;
+
+	if (dms_fallback == "ALL") {
+		_dms_fallback = DMS_FALLBACK_ALL;
+	} else if (dms_fallback == "LEGACY") {
+		_dms_fallback = DMS_FALLBACK_LEGACY;
+	} else if (dms_fallback == "DROP") {
+		_dms_fallback = DMS_FALLBACK_DROP;
+	} else {
+		return errh->error("DMS_FALLBACK must be ALL, LEGACY or DROP");
+	}
+
+	return res;
+
 }
 
 void
@@ -70,7 +92,6 @@ EmpowerWifiEncap::push(int, Packet *p) {
 	// unicast traffic
 	if (!dst.is_broadcast() && !dst.is_group()) {
         EmpowerStationState *ess = _el->get_ess(dst);
-        TxPolicyInfo *txp = _el->get_txp(dst);
         if (!ess) {
 			p->kill();
 			return;
@@ -95,7 +116,7 @@ EmpowerWifiEncap::push(int, Packet *p) {
 			p->kill();
 			return;
 		}
-		txp->update_tx(p->length());
+		ess->_txp->update_tx(p->length());
 		Packet * p_out = wifi_encap(p, dst, src, ess->_lvap_bssid);
 		SET_PAINT_ANNO(p_out, ess->_iface_id);
 		output(0).push(p_out);
@@ -107,90 +128,181 @@ EmpowerWifiEncap::push(int, Packet *p) {
 	for (int i = 0; i < _el->num_ifaces(); i++) {
 
 		TxPolicyInfo * tx_policy = _el->get_tx_policies(i)->lookup(dst);
+		EmpowerIfaceIndex * idx = _el->iface_index(i);
 
 		if (tx_policy->_tx_mcast == TX_MCAST_DMS) {
 
-			// dms mcast policy, duplicate the frame for each station in
-			// each bssid and use unicast destination addresses. note that
-			// a given station cannot be in more than one bssid, so just
-			// track if the frame has already been delivered to a given
-			// station.
+			// dms mcast policy, duplicate the frame for each receiver of
+			// the group and use unicast destination addresses.
+			send_dms(p, dst, src, tx_policy, i, idx);
 
-			Vector<EtherAddress> sent;
+		} else if (tx_policy->_tx_mcast == TX_MCAST_UR) {
 
-			for (LVAPIter it = _el->lvaps()->begin(); it.live(); it++) {
-				EtherAddress sta = it.value()._sta;
-				if (it.value()._iface_id != i) {
-					continue;
-				}
-				if (!it.value()._set_mask) {
+			// unsolicited retries mcast policy, send the frame once for
+			// each bssid like the legacy policy and then repeat it
+			// _ur_mcast_count times with the retry bit set. WifiSeq
+			// (GROUP_RETRIES) gives the copies the sequence number of
+			// the original, so receivers drop the copies they already
+			// got. the airtime does not depend on the number of receivers.
+
+			URGroupStats *stats = get_ur_group(dst);
+
+			for (int j = 0; j < idx->_bssids.size(); j++) {
+				Packet *q = p->clone();
+				if (!q) {
 					continue;
 				}
-				if (!it.value()._authentication_status) {
+				Packet * p_out = wifi_encap(q, dst, src, idx->_bssids[j]);
+				if (!p_out) {
 					continue;
 				}
-				if (!it.value()._association_status) {
-					continue;
+				tx_policy->update_tx(p->length());
+				SET_PAINT_ANNO(p_out, i);
+				WritablePacket *retry = 0;
+				if (tx_policy->_ur_mcast_count > 0) {
+					Packet *r = p_out->clone();
+					retry = r ? r->uniqueify() : 0;
 				}
-				if (find(sent.begin(), sent.end(), sta) != sent.end()) {
+				output(0).push(p_out);
+				stats->_frames++;
+				stats->_transmissions++;
+				stats->_bytes += p->length();
+				if (!retry) {
 					continue;
 				}
-				sent.push_back(sta);
-				Packet *q = p->clone();
-				if (!q) {
-					continue;
+				struct click_wifi *w = (struct click_wifi *) retry->data();
+				w->i_fc[1] |= WIFI_FC1_RETRY;
+				for (int k = 1; k < tx_policy->_ur_mcast_count; k++) {
+					Packet *r = retry->clone();
+					if (!r) {
+						break;
+					}
+					output(0).push(r);
+					stats->_transmissions++;
 				}
-				Packet * p_out = wifi_encap(q, sta, src, it.value()._lvap_bssid);
-				tx_policy->update_tx(p->length());
-				SET_PAINT_ANNO(p_out, i);
-				output(0).push(p_out);
+				output(0).push(retry);
+				stats->_transmissions++;
 			}
 
-		} else if (tx_policy->_tx_mcast == TX_MCAST_UR) {
-
-			// TODO: implement
-
 		} else {
 
 			// legacy mcast policy, just send the frame as it is, minstrel will
 			// pick the rate from the transmission policies table
+			send_legacy(p, dst, src, tx_policy, i, idx);
 
-			Vector<EtherAddress> sent;
+		}
 
-			for (LVAPIter it = _el->lvaps()->begin(); it.live(); it++) {
-				EtherAddress bssid = it.value()._lvap_bssid;
-				if (it.value()._iface_id != i) {
-					continue;
-				}
-				if (!it.value()._set_mask) {
-					continue;
-				}
-				if (!it.value()._authentication_status) {
-					continue;
-				}
-				if (!it.value()._association_status) {
-					continue;
-				}
-				if (find(sent.begin(), sent.end(), bssid) != sent.end()) {
-					continue;
-				}
-				sent.push_back(bssid);
-				Packet *q = p->clone();
-				if (!q) {
-					continue;
+	}
+
+	p->kill();
+	return;
+
+}
+
+URGroupStats *
+EmpowerWifiEncap::get_ur_group(EtherAddress dst) {
+
+	URGroupStats *stats = _ur_groups.get_pointer(dst);
+
+	if (!stats) {
+		// forget the group that has been idle the longest
+		if (_ur_groups.size() >= UR_GROUPS_MAX) {
+			URGroupsIter oldest = _ur_groups.begin();
+			for (URGroupsIter it = _ur_groups.begin(); it.live(); it++) {
+				if (it.value()._last_sent < oldest.value()._last_sent) {
+					oldest = it;
 				}
-				Packet * p_out = wifi_encap(q, dst, src, bssid);
-				tx_policy->update_tx(p->length());
-				SET_PAINT_ANNO(p_out, i);
-				output(0).push(p_out);
 			}
+			_ur_groups.erase(oldest.key());
+		}
+		_ur_groups.set(dst, URGroupStats());
+		stats = _ur_groups.get_pointer(dst);
+	}
+
+	stats->_last_sent = Timestamp::now_steady();
+
+	return stats;
+
+}
+
+void
+EmpowerWifiEncap::send_dms(Packet *p, EtherAddress dst, EtherAddress src,
+		TxPolicyInfo *tx_policy, int iface_id, EmpowerIfaceIndex *idx) {
+
+	Vector<EmpowerMulticastTable::EmpowerMulticastReceiver> *receivers = 0;
+
+	if (_mtbl && !dst.is_broadcast()) {
+		receivers = _mtbl->getIGMPreceivers(dst);
+	}
 
+	if (receivers) {
+		// only the stations that joined the group and are served by
+		// this interface
+		for (int j = 0; j < receivers->size(); j++) {
+			EmpowerStationState *ess = _el->get_ess((*receivers)[j].sta);
+			if (!ess || ess->_mcast_iface != iface_id) {
+				continue;
+			}
+			Packet *q = p->clone();
+			if (!q) {
+				continue;
+			}
+			Packet * p_out = wifi_encap(q, ess->_sta, src, ess->_mcast_bssid);
+			if (!p_out) {
+				continue;
+			}
+			tx_policy->update_tx(p->length());
+			SET_PAINT_ANNO(p_out, iface_id);
+			output(0).push(p_out);
+			_dms_receivers_frames++;
 		}
+		return;
+	}
 
+	if (_dms_fallback == DMS_FALLBACK_DROP) {
+		return;
 	}
 
-	p->kill();
-	return;
+	if (_dms_fallback == DMS_FALLBACK_LEGACY) {
+		send_legacy(p, dst, src, tx_policy, iface_id, idx);
+		return;
+	}
+
+	// the index lists every station of this interface exactly once
+	for (int j = 0; j < idx->_stas.size(); j++) {
+		Packet *q = p->clone();
+		if (!q) {
+			continue;
+		}
+		Packet * p_out = wifi_encap(q, idx->_stas[j], src, idx->_stas_bssids[j]);
+		if (!p_out) {
+			continue;
+		}
+		tx_policy->update_tx(p->length());
+		SET_PAINT_ANNO(p_out, iface_id);
+		output(0).push(p_out);
+		_dms_fallback_frames++;
+	}
+
+}
+
+void
+EmpowerWifiEncap::send_legacy(Packet *p, EtherAddress dst, EtherAddress src,
+		TxPolicyInfo *tx_policy, int iface_id, EmpowerIfaceIndex *idx) {
+
+	for (int j = 0; j < idx->_bssids.size(); j++) {
+		Packet *q = p->clone();
+		if (!q) {
+			continue;
+		}
+		Packet * p_out = wifi_encap(q, dst, src, idx->_bssids[j]);
+		if (!p_out) {
+			continue;
+		}
+		tx_policy->update_tx(p->length());
+		SET_PAINT_ANNO(p_out, iface_id);
+		output(0).push(p_out);
+	}
 
 }
 
@@ -262,7 +374,9 @@ EmpowerWifiEncap::wifi_encap(Packet *q, EtherAddress dst, EtherAddress src, Ethe
 }
 
 enum {
-	H_DEBUG
+	H_DEBUG,
+	H_UR_GROUPS,
+	H_DMS
 };
 
 String EmpowerWifiEncap::read_handler(Element *e, void *thunk) {
@@ -270,6 +384,23 @@ String EmpowerWifiEncap::read_handler(Element *e, void *thunk) {
 	switch ((uintptr_t) thunk) {
 	case H_DEBUG:
 		return String(td->_debug) + "\n";
+	case H_DMS: {
+		StringAccum sa;
+		sa << "receivers " << td->_dms_receivers_frames;
+		sa << " fallback " << td->_dms_fallback_frames << "\n";
+		return sa.take_string();
+	}
+	case H_UR_GROUPS: {
+		StringAccum sa;
+		for (URGroupsIter it = td->_ur_groups.begin(); it.live(); it++) {
+			sa << it.key().unparse();
+			sa << " frames " << it.value()._frames;
+			sa << " transmissions " << it.value()._transmissions;
+			sa << " bytes " << it.value()._bytes;
+			sa << "\n";
+		}
+		return sa.take_string();
+	}
 	default:
 		return String();
 	}
@@ -295,6 +426,8 @@ int EmpowerWifiEncap::write_handler(const String &in_s, Element *e,
 
 void EmpowerWifiEncap::add_handlers() {
 	add_read_handler("debug", read_handler, (void *) H_DEBUG);
+	add_read_handler("ur_groups", read_handler, (void *) H_UR_GROUPS);
+	add_read_handler("dms", read_handler, (void *) H_DMS);
 	add_write_handler("debug", write_handler, (void *) H_DEBUG);
 }
 
@@ -5,6 +5,8 @@
 #include <click/element.hh>
 #include <clicknet/ether.h>
 #include <click/etheraddress.hh>
+#include <click/hashtable.hh>
+#include <click/timestamp.hh>
 CLICK_DECLS
 
 /*
@@ -28,14 +30,58 @@ Arguments are:
 =item EL
 An EmpowerLVAPManager element
 
+=item MTBL
+An EmpowerMulticastTable element. If set, multicast frames sent with the
+DMS policy are only duplicated to the stations that joined the
+destination group. The lookup is by destination MAC address, so DMS
+relies on the table's mapping from MAC address to IP groups: the frames
+go to the receivers the table reports for that address, and a group the
+table does not know (no IGMP report seen yet) takes DMS_FALLBACK.
+
+=item DMS_FALLBACK
+What to do with DMS frames whose destination is not a known IGMP group
+(e.g. broadcast or mDNS). ALL duplicates them to every station, LEGACY
+sends them once per BSSID as with the legacy policy, DROP discards them.
+Default is ALL.
+
 =item DEBUG
 Turn debug on/off
 
 =back 8
 
+=h dms read-only
+DMS frames sent to group receivers and through the fallback
+
+=h ur_groups read-only
+Frames, transmissions and bytes sent for each multicast group using the
+unsolicited retries (UR) policy. Only the 256 groups used most recently
+are kept. The repeats carry the retry bit, WifiSeq must be configured
+with GROUP_RETRIES for receivers to discard them.
+
 =a EmpowerWifiDecap
 */
 
+class URGroupStats {
+public:
+	uint32_t _frames;
+	uint32_t _transmissions;
+	uint64_t _bytes;
+	Timestamp _last_sent;
+	URGroupStats() : _frames(0), _transmissions(0), _bytes(0) { }
+};
+
+typedef HashTable<EtherAddress, URGroupStats> URGroups;
+typedef URGroups::iterator URGroupsIter;
+
+enum empower_dms_fallback_type {
+	DMS_FALLBACK_ALL = 0x0,
+	DMS_FALLBACK_LEGACY = 0x1,
+	DMS_FALLBACK_DROP = 0x2,
+};
+
+class EmpowerIfaceIndex;
+class TxPolicyInfo;
+
 class EmpowerWifiEncap: public Element {
 public:
 
@@ -53,10 +99,23 @@ public:
 private:
 
 	class EmpowerLVAPManager *_el;
+	class EmpowerMulticastTable *_mtbl;
+
+	empower_dms_fallback_type _dms_fallback;
 
 	bool _debug;
 
+	URGroups _ur_groups;
+	enum { UR_GROUPS_MAX = 256 };
+
+	uint32_t _dms_receivers_frames;
+	uint32_t _dms_fallback_frames;
+
 	Packet *wifi_encap(Packet *, EtherAddress, EtherAddress, EtherAddress);
+	URGroupStats *get_ur_group(EtherAddress);
+
+	void send_dms(Packet *, EtherAddress, EtherAddress, TxPolicyInfo *, int, EmpowerIfaceIndex *);
+	void send_legacy(Packet *, EtherAddress, EtherAddress, TxPolicyInfo *, int, EmpowerIfaceIndex *);
 
 	static int write_handler(const String &, Element *, void *, ErrorHandler *);
 	static String read_handler(Element *, void *);
@@ -15,14 +15,13 @@ public:
 	EtherAddress _eth;
 	empower_trigger_relation _rel;
 	int _val;
-	bool _dispatched;
 
-	RssiTrigger(EtherAddress, uint32_t, empower_trigger_relation, int, bool, uint16_t, EmpowerLVAPManager *, EmpowerRXStats *);
+	RssiTrigger(EtherAddress, uint32_t, empower_trigger_relation, int, uint16_t, EmpowerLVAPManager *, EmpowerRXStats *);
 	~RssiTrigger();
 
 	String unparse();
 
-	bool matches(const DstInfo* nfo);
+	bool matches(int value);
 
 	inline bool operator==(const RssiTrigger &b) {
 		return (_eth == b._eth) && (_rel == b._rel) && (_val == b._val);
@@ -0,0 +1,70 @@
+#ifndef CLICK_EMPOWER_RXSTATSSHARD_HH
+#define CLICK_EMPOWER_RXSTATSSHARD_HH
+#include <click/etheraddress.hh>
+#include <click/hashtable.hh>
+#include <click/timestamp.hh>
+#include <click/sync.hh>
+#include <elements/wifi/bitrate.hh>
+CLICK_DECLS
+
+// RSSI samples received from one neighbour during the current period
+class NeighborSample {
+public:
+	int _iface_id;
+	int _packets;
+	int _accum_rssi;
+	int _squares_rssi;
+	Timestamp _last_received;
+
+	NeighborSample() {
+		_iface_id = -1;
+		_packets = 0;
+		_accum_rssi = 0;
+		_squares_rssi = 0;
+	}
+
+	void add_sample(uint8_t rssi) {
+		_packets++;
+		_accum_rssi += rssi;
+		_squares_rssi += rssi * rssi;
+		_last_received.assign_now();
+	}
+};
+
+// Airtime of the frames received on one interface during the current period
+class BusynessSample {
+public:
+	int _packets;
+	uint32_t _accum_busyness; // usec
+
+	BusynessSample() {
+		_packets = 0;
+		_accum_busyness = 0;
+	}
+
+	void add_sample(uint32_t len, uint8_t rate) {
+		_packets++;
+		_accum_busyness += calc_usecs_wifi_packet(len, rate, 0);
+	}
+};
+
+typedef HashTable<EtherAddress, NeighborSample> NeighborSamples;
+typedef NeighborSamples::iterator NSIter;
+
+typedef HashTable<int, BusynessSample> BusynessSamples;
+typedef BusynessSamples::iterator BSIter;
+
+// Samples collected by the RX path of EmpowerRXStats for one interface.
+// A shard is only written by the thread receiving on that interface and
+// emptied once per period by EmpowerRXStats::run_timer(), so the lock is
+// uncontended on the fast path.
+class RXStatsShard {
+public:
+	SimpleSpinlock _lock;
+	NeighborSamples _stas;
+	NeighborSamples _aps;
+	BusynessSamples _busyness;
+};
+
+CLICK_ENDDECLS
+#endif /* CLICK_EMPOWER_RXSTATSSHARD_HH */
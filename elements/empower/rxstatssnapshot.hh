@@ -0,0 +1,138 @@
+#ifndef CLICK_EMPOWER_RXSTATSSNAPSHOT_HH
+#define CLICK_EMPOWER_RXSTATSSNAPSHOT_HH
+#include <click/straccum.hh>
+#include <click/etheraddress.hh>
+#include <click/timestamp.hh>
+#include <click/vector.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+// Statistics of one neighbour at the end of a period
+class NeighborStats {
+public:
+	EtherAddress _eth;
+	int _sender_type;
+	int _iface_id;
+	int _last_rssi;
+	int _last_std;
+	int _last_packets;
+	int _hist_packets;
+	int _mov_rssi;
+	unsigned _silent_window_count;
+	Timestamp _last_received;
+
+	String unparse(const Timestamp &now) const {
+		StringAccum sa;
+		Timestamp age = now - _last_received;
+		sa << _eth.unparse();
+		sa << (_sender_type == 0 ? " STA" : " AP");
+		sa << " sma_rssi " << _mov_rssi;
+		sa << " last_rssi_avg " << _last_rssi;
+		sa << " last_rssi_std " << _last_std;
+		sa << " last_packets " << _last_packets;
+		sa << " hist_packets " << _hist_packets;
+		sa << " last_received " << age;
+		sa << " silent_window_count " << _silent_window_count;
+		sa << " iface_id " << _iface_id << "\n";
+		return sa.take_string();
+	}
+};
+
+// Channel busyness of one interface at the end of a period
+class BusynessStats {
+public:
+	int _iface_id;
+	uint32_t _last_busyness;
+	uint32_t _sma_busyness;
+	int _last_packets;
+	unsigned _silent_window_count;
+	Timestamp _last_updated;
+
+	String unparse(const Timestamp &now) const {
+		StringAccum sa;
+		Timestamp age = now - _last_updated;
+		sa << "iface_id " << _iface_id;
+		sa << " last_busyness " << ((double) _last_busyness / 18000);
+		sa << " sma_busyness " << ((double) _sma_busyness / 18000);
+		sa << " last_packets " << _last_packets;
+		sa << " last_received " << age;
+		sa << " silent_window_count " << _silent_window_count << "\n";
+		return sa.take_string();
+	}
+};
+
+// Neighbours grouped by interface. Entries of interface i are at
+// [_first[i], _first[i + 1]) in both _stats and _wire; _wire holds the
+// same entries already encoded as cqm_entry, _wire_len bytes each. The
+// encoding is done by EmpowerRXStats, this header cannot see the wire
+// structs (empowerpacket.hh includes us through empowerlvapmanager.hh).
+class NeighborStatsTable {
+public:
+	Vector<NeighborStats> _stats;
+	Vector<uint8_t> _wire;
+	int _wire_len;
+	Vector<int> _first;
+
+	NeighborStatsTable() : _wire_len(0) {
+	}
+
+	void clear() {
+		_stats.clear();
+		_wire.clear();
+		_first.clear();
+	}
+
+	int nb_ifaces() const {
+		return _first.size() ? _first.size() - 1 : 0;
+	}
+
+	int begin(int iface_id) const {
+		return (iface_id >= 0 && iface_id < nb_ifaces()) ? _first[iface_id] : 0;
+	}
+
+	int end(int iface_id) const {
+		return (iface_id >= 0 && iface_id < nb_ifaces()) ? _first[iface_id + 1] : 0;
+	}
+
+	int count(int iface_id) const {
+		return end(iface_id) - begin(iface_id);
+	}
+
+	const uint8_t *wire(int iface_id) const {
+		return count(iface_id) ? &_wire[begin(iface_id) * _wire_len] : 0;
+	}
+};
+
+// Immutable view of the RX statistics published by EmpowerRXStats at the
+// end of every period. Readers pin it with EmpowerRXStats::acquire_snapshot()
+// and release it when done; the writer only rebuilds snapshots that are
+// neither published nor pinned, so readers never take a lock.
+class RXStatsSnapshot {
+public:
+	atomic_uint32_t _refs;
+	uint32_t _epoch;
+	Timestamp _taken;
+	NeighborStatsTable _stas;
+	NeighborStatsTable _aps;
+	Vector<BusynessStats> _busyness; // indexed by iface id, -1 if unused
+
+	RXStatsSnapshot() : _epoch(0) {
+		_refs = 0;
+	}
+
+	void clear() {
+		_stas.clear();
+		_aps.clear();
+		_busyness.clear();
+	}
+
+	const BusynessStats *busyness(int iface_id) const {
+		if (iface_id < 0 || iface_id >= _busyness.size() || _busyness[iface_id]._iface_id < 0) {
+			return 0;
+		}
+		return &_busyness[iface_id];
+	}
+};
+
+CLICK_ENDDECLS
+#endif /* CLICK_EMPOWER_RXSTATSSNAPSHOT_HH */
@@ -13,9 +13,24 @@ public:
 		period(period), window(new int[period]), head(NULL), tail(NULL), total(0) {
 		assert(period >= 1);
 	}
+	SMA(const SMA &o) :
+		period(o.period), window(new int[o.period]), head(NULL), tail(NULL), total(0) {
+		copy_from(o);
+	}
 	~SMA() {
 		delete[] window;
 	}
+	SMA &operator=(const SMA &o) {
+		if (this != &o) {
+			if (period != o.period) {
+				delete[] window;
+				period = o.period;
+				window = new int[period];
+			}
+			copy_from(o);
+		}
+		return *this;
+	}
 	// Adds a value to the average, pushing one out if necessary
 	void add(int val) {
 		// Special case: Initialisation
@@ -61,6 +76,14 @@ private:
 
 	int total; // Cache the total so we don't sum everything each time.
 
+	// Copies the window of another SMA with the same period.
+	void copy_from(const SMA &o) {
+		memcpy(window, o.window, period * sizeof(int));
+		head = o.head ? window + (o.head - o.window) : NULL;
+		tail = o.tail ? window + (o.tail - o.window) : NULL;
+		total = o.total;
+	}
+
 	// Bumps the given pointer up by one.
 	// Wraps to the start of the array if needed.
 	void inc(int * & p) {
@@ -22,8 +22,13 @@
 CLICK_DECLS
 
 SummaryTrigger::SummaryTrigger(int iface, EtherAddress eth, uint32_t trigger_id, int16_t limit,
-		uint16_t period, EmpowerLVAPManager * el, EmpowerRXStats * ers) :
-		Trigger(trigger_id, period, el, ers), _eth(eth), _iface(iface), _sent(0), _limit(limit) {
+		uint16_t period, int max_frames, uint32_t sampling, bool reservoir,
+		EmpowerLVAPManager * el, EmpowerRXStats * ers) :
+		Trigger(trigger_id, period, el, ers), _eth(eth), _iface(iface), _sent(0), _limit(limit),
+		_head(0), _nb_frames(0), _sampling(sampling ? sampling : 1), _reservoir(reservoir),
+		_seen(0), _dropped(0), _total_dropped(0) {
+
+	_frames.resize(max_frames > 0 ? max_frames : 1);
 
 }
 
@@ -31,6 +36,50 @@ SummaryTrigger::~SummaryTrigger() {
 	_frames.clear();
 }
 
+void SummaryTrigger::add_frame(const Frame &frame) {
+
+	_seen++;
+
+	// keep one frame every _sampling
+	if (_sampling > 1 && (_seen - 1) % _sampling != 0) {
+		_dropped++;
+		return;
+	}
+
+	int capacity = _frames.size();
+
+	if (_nb_frames < capacity) {
+		_frames[(_head + _nb_frames) % capacity] = frame;
+		_nb_frames++;
+		return;
+	}
+
+	_dropped++;
+
+	if (_reservoir) {
+		// the sampled frames seen so far, candidates for the reservoir
+		uint32_t candidates = (_seen - 1) / _sampling + 1;
+		uint32_t slot = click_random(0, candidates - 1);
+		if (slot < (uint32_t) capacity) {
+			_frames[(_head + slot) % capacity] = frame;
+		}
+		return;
+	}
+
+	// overwrite the oldest frame
+	_frames[_head] = frame;
+	_head = (_head + 1) % capacity;
+
+}
+
+void SummaryTrigger::clear_frames() {
+	_total_dropped += _dropped;
+	_head = 0;
+	_nb_frames = 0;
+	_seen = 0;
+	_dropped = 0;
+}
+
 String SummaryTrigger::unparse() {
 	StringAccum sa;
 	sa << Trigger::unparse();
@@ -41,7 +90,14 @@ String SummaryTrigger::unparse() {
 	sa << " period ";
 	sa << _period;
 	sa << " frames ";
+	sa << _nb_frames;
+	sa << "/";
 	sa << _frames.size();
+	sa << " sampling ";
+	sa << _sampling;
+	sa << (_reservoir ? " reservoir" : " ring");
+	sa << " dropped ";
+	sa << (_total_dropped + _dropped);
 	sa << " sent ";
 	sa << _sent;
 	return sa.take_string();
@@ -19,11 +19,33 @@ public:
 	int _iface;
 	uint32_t _sent;
 	int16_t _limit;
+
+	// Preallocated ring of captured frames. When the ring is full the
+	// oldest frame is overwritten, or, in reservoir mode, a uniformly
+	// random slot is replaced so the batch samples the whole period.
 	FramesList _frames;
+	int _head;
+	int _nb_frames;
+	uint32_t _sampling;
+	bool _reservoir;
+
+	uint32_t _seen;
+	uint32_t _dropped;
+	uint32_t _total_dropped;
 
-	SummaryTrigger(int, EtherAddress, uint32_t, int16_t, uint16_t, EmpowerLVAPManager *, EmpowerRXStats *);
+	SummaryTrigger(int, EtherAddress, uint32_t, int16_t, uint16_t, int, uint32_t, bool, EmpowerLVAPManager *, EmpowerRXStats *);
 	~SummaryTrigger();
 
+	void add_frame(const Frame &);
+	void clear_frames();
+
+	int nb_frames() const { return _nb_frames; }
+
+	// i-th frame of the current batch, oldest first
+	const Frame &frame(int i) const {
+		return _frames[(_head + i) % _frames.size()];
+	}
+
 	String unparse();
 
 	inline bool operator==(const SummaryTrigger &b) {
@@ -10,6 +10,8 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 #include <fcntl.h>
@@ -23,14 +25,26 @@
 
 CLICK_DECLS
 
+// every message on the controller channel starts with a version octet,
+// a type octet and a 32 bit length (network order, header included)
+#define EMPOWER_MSG_HEADER_LEN	10
+#define EMPOWER_MSG_LENGTH_OFF	2
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
 EmpSocket::EmpSocket()
-  : _task(this), _timer(this),
-    _fd(-1), _active(-1), _rq(0), _wq(0),
+  : _task(this), _timer(this), _flush_timer(this),
+    _fd(-1), _active(-1), _rq(0), _rq_fill(0), _wq(0),
     _local_port(0), _local_pathname(""),
     _timestamp(true), _sndbuf(-1), _rcvbuf(-1),
-    _snaplen(2048), _headroom(Packet::default_headroom), _nodelay(1),
+    _snaplen(65536), _max_msg_len(1 << 20),
+    _headroom(Packet::default_headroom), _nodelay(1),
     _verbose(false), _client(false), _proper(false), _allow(0), _deny(0), 
-    _reconnect_call_h(0), have_master(false)
+    have_master(false), _reconnect_call_h(0), _nb_reads(0), _nb_batches(0), _nb_messages(0),
+    _oq_bytes(0), _oq_highwater(0), _oq_blocked(false), _oq_drops(0), _nb_writes(0),
+    _flush_bytes(16384), _flush_usec(1000), _queue_limit(4 << 20)
 {
 }
 
@@ -38,7 +52,12 @@ EmpSocket::~EmpSocket()
 {
 }
 
-void EmpSocket::run_timer(Timer *) {
+void EmpSocket::run_timer(Timer *t) {
+
+  if (t == &_flush_timer) {
+    flush_queue();
+    return;
+  }
 
   ErrorHandler *errh = new ErrorHandler();
 
@@ -96,6 +115,10 @@ EmpSocket::configure(Vector<String> &conf, ErrorHandler *errh)
   Element *allow = 0, *deny = 0;
   if (args.read("VERBOSE", _verbose)
       .read("SNAPLEN", _snaplen)
+      .read("MAX_MSG_LEN", _max_msg_len)
+      .read("FLUSH_BYTES", _flush_bytes)
+      .read("FLUSH_USEC", _flush_usec)
+      .read("QUEUE_LIMIT", _queue_limit)
       .read("HEADROOM", _headroom)
       .read("TIMESTAMP", _timestamp)
       .read("RCVBUF", _rcvbuf)
@@ -109,6 +132,12 @@ EmpSocket::configure(Vector<String> &conf, ErrorHandler *errh)
       .consume() < 0)
     return -1;
 
+  if (_snaplen < EMPOWER_MSG_HEADER_LEN)
+    return errh->error("SNAPLEN must be at least %d", EMPOWER_MSG_HEADER_LEN);
+
+  if (_max_msg_len < EMPOWER_MSG_HEADER_LEN)
+    return errh->error("MAX_MSG_LEN must be at least %d", EMPOWER_MSG_HEADER_LEN);
+
   if (reconnect_call)
     _reconnect_call_h = new HandlerCall(reconnect_call);
 
@@ -195,9 +224,11 @@ EmpSocket::initialize(ErrorHandler *errh)
     }
   }
   
-  // initialize timer
+  // initialize timers
   _timer.initialize(this);
   _timer.reschedule_after_sec(2);
+  if (!_flush_timer.initialized())
+    _flush_timer.initialize(this);
 
   // initialize callback
   if (_reconnect_call_h && (_reconnect_call_h->initialize_write(this, errh) < 0))
@@ -346,6 +377,7 @@ EmpSocket::cleanup(CleanupStage)
     _rq->kill();
   if (_wq)
     _wq->kill();
+  clear_queue();
   if (_fd >= 0) {
     // shut down the listening socket in case we forked
 #ifdef SHUT_RDWR
@@ -383,17 +415,185 @@ EmpSocket::close_active(void)
       click_chatter("%s: closed connection %d", declaration().c_str(), _active);
     _active = -1;
   }
+  // a partial message from the old connection is meaningless on the next
+  // one, and so are the replies still queued for it
+  _rq_fill = 0;
+  clear_queue();
+}
+
+void
+EmpSocket::clear_queue(void)
+{
+  for (int i = 0; i < _oq.size(); i++)
+    _oq[i]->kill();
+  _oq.clear();
+  _oq_bytes = 0;
+  if (_flush_timer.initialized())
+    _flush_timer.unschedule();
+}
+
+void
+EmpSocket::enqueue_packet(Packet *p)
+{
+  if (_oq_bytes + p->length() > _queue_limit) {
+    if (_verbose)
+      click_chatter("%s: outbound queue full (%u bytes), dropping packet",
+		    declaration().c_str(), _oq_bytes);
+    _oq_drops++;
+    p->kill();
+    return;
+  }
+
+  _oq.push_back(p);
+  _oq_bytes += p->length();
+  if (_oq_bytes > _oq_highwater)
+    _oq_highwater = _oq_bytes;
+
+  if (_oq_bytes >= _flush_bytes || _flush_usec == 0)
+    flush_queue();
+  else if (!_flush_timer.scheduled())
+    _flush_timer.schedule_after(Timestamp::make_usec(_flush_usec));
 }
 
 void
-EmpSocket::selected(int fd, int)
+EmpSocket::flush_queue(void)
+{
+  _flush_timer.unschedule();
+
+  while (_oq.size() && _active >= 0) {
+    struct iovec iov[IOV_MAX];
+    int n = (_oq.size() < IOV_MAX) ? _oq.size() : IOV_MAX;
+    for (int i = 0; i < n; i++) {
+      iov[i].iov_base = (void *) _oq[i]->data();
+      iov[i].iov_len = _oq[i]->length();
+    }
+
+    ssize_t len = writev(_active, iov, n);
+
+    if (len < 0) {
+      // interrupted by signal, try again immediately
+      if (errno == EINTR)
+	continue;
+      // would block, resume when the socket becomes writable
+      if (errno == EAGAIN || errno == ENOBUFS) {
+	add_select(_active, SELECT_WRITE);
+	_oq_blocked = true;
+	return;
+      }
+      // connection probably terminated or other fatal error
+      if (_verbose)
+	click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+      close_active();
+      return;
+    }
+
+    _nb_writes++;
+    _oq_bytes -= len;
+
+    // release what went out, a partially written packet stays at the head
+    int done = 0;
+    while (done < _oq.size() && len >= (ssize_t) _oq[done]->length()) {
+      len -= _oq[done]->length();
+      _oq[done]->kill();
+      done++;
+    }
+    if (len > 0)
+      _oq[done]->pull(len);
+    if (done) {
+      for (int i = done; i < _oq.size(); i++)
+	_oq[i - done] = _oq[i];
+      _oq.resize(_oq.size() - done);
+    }
+  }
+
+  if (_oq_blocked && _active >= 0 && !(ninputs() && input_is_pull(0)))
+    remove_select(_active, SELECT_WRITE);
+  _oq_blocked = false;
+}
+
+void
+EmpSocket::push_messages(void)
+{
+  // walk the messages accumulated so far, stop at the first incomplete one
+  uint32_t offset = 0;
+  uint32_t pending = 0;
+
+  while (_rq_fill - offset >= EMPOWER_MSG_HEADER_LEN) {
+    uint32_t msg_len;
+    memcpy(&msg_len, _rq->data() + offset + EMPOWER_MSG_LENGTH_OFF, sizeof(msg_len));
+    msg_len = ntohl(msg_len);
+    if (msg_len < EMPOWER_MSG_HEADER_LEN || msg_len > _max_msg_len) {
+      // the stream cannot be resynchronized, start over
+      click_chatter("%s: invalid message length %u, closing connection %d",
+		    declaration().c_str(), msg_len, _active);
+      close_active();
+      return;
+    }
+    if (_rq_fill - offset < msg_len) {
+      pending = msg_len;
+      break;
+    }
+    offset += msg_len;
+    _nb_messages++;
+  }
+
+  if (offset == 0) {
+    // nothing complete yet, make room for the pending message if needed
+    if (pending > _rq->length()) {
+      WritablePacket *q = Packet::make(_headroom, 0, pending, 0);
+      if (!q) {
+	click_chatter("%s: cannot buffer %u bytes, closing connection %d",
+		      declaration().c_str(), pending, _active);
+	close_active();
+	return;
+      }
+      memcpy(q->data(), _rq->data(), _rq_fill);
+      _rq->kill();
+      _rq = q;
+    }
+    return;
+  }
+
+  // carry the trailing partial message over to a fresh buffer and hand
+  // all complete messages downstream at once, without copying them
+  uint32_t tail = _rq_fill - offset;
+  uint32_t size = (pending > (uint32_t) _snaplen) ? pending : _snaplen;
+  WritablePacket *next = Packet::make(_headroom, 0, size, 0);
+  if (!next) {
+    click_chatter("%s: cannot make packet, closing connection %d",
+		  declaration().c_str(), _active);
+    close_active();
+    return;
+  }
+  if (tail)
+    memcpy(next->data(), _rq->data() + offset, tail);
+
+  _rq->take(_rq->length() - offset);
+
+  if (_timestamp)
+    _rq->timestamp_anno().assign_now();
+
+  WritablePacket *p = _rq;
+  _rq = next;
+  _rq_fill = tail;
+  _nb_batches++;
+
+  output(0).push(p);
+}
+
+void
+EmpSocket::selected(int fd, int mask)
 {
   int len;
   union { struct sockaddr_in in; struct sockaddr_un un; } from;
   socklen_t from_len = sizeof(from);
   bool allow;
 
-  if (noutputs()) {
+  // the socket drained, send whatever is still queued
+  if ((mask & SELECT_WRITE) && _oq.size())
+    flush_queue();
+
+  if (noutputs() && (mask & SELECT_READ)) {
     // accept new connections
     if (_socktype == SOCK_STREAM && !_client && _active < 0 && fd == _fd) {
       _active = accept(_fd, (struct sockaddr *)&from, &from_len);
@@ -433,7 +633,7 @@ EmpSocket::selected(int fd, int)
       _rq = Packet::make(_headroom, 0, _snaplen, 0);
     if (_rq) {
       if (_socktype == SOCK_STREAM)
-	len = read(_active, _rq->data(), _rq->length());
+	len = read(_active, _rq->data() + _rq_fill, _rq->length() - _rq_fill);
       else if (_client)
 	len = recv(_active, _rq->data(), _rq->length(), MSG_TRUNC);
       else {
@@ -452,8 +652,15 @@ EmpSocket::selected(int fd, int)
 	}
       }
 
-      // this segment OK
-      if (len > 0) {
+      // stream segment OK, only complete messages are pushed
+      if (len > 0 && _socktype == SOCK_STREAM) {
+	_nb_reads++;
+	_rq_fill += len;
+	push_messages();
+      }
+
+      // datagram OK
+      else if (len > 0) {
 	if (len > _snaplen) {
 	  // truncate packet to max length (should never happen)
 	  assert(_rq->length() == (uint32_t)_snaplen);
@@ -546,6 +753,13 @@ EmpSocket::push(int, Packet *p)
     return;
   }
   
+  // stream sockets never block the router thread: packets are queued
+  // and coalesced into as few writes as possible
+  if (_active >= 0 && _socktype == SOCK_STREAM) {
+    enqueue_packet(p);
+    return;
+  }
+
   if (_active >= 0) {
     // block
     do {
@@ -618,6 +832,22 @@ String EmpSocket::read_handler(Element *e, void *thunk) {
       click_chatter("EmpSocket: got restart signal, closing and starting again");
       es->close_active();
       return String("done");
+    case 1:
+      return String(es->_nb_reads) + "\n";
+    case 2:
+      return String(es->_nb_batches) + "\n";
+    case 3:
+      return String(es->_nb_messages) + "\n";
+    case 4:
+      return String(es->_oq.size()) + "\n";
+    case 5:
+      return String(es->_oq_bytes) + "\n";
+    case 6:
+      return String(es->_oq_highwater) + "\n";
+    case 7:
+      return String(es->_oq_drops) + "\n";
+    case 8:
+      return String(es->_nb_writes) + "\n";
     default:
       return String();
   }
@@ -628,6 +858,14 @@ EmpSocket::add_handlers()
 {
   add_task_handlers(&_task);
   add_read_handler("restart", read_handler, (void *) 0);
+  add_read_handler("reads", read_handler, (void *) 1);
+  add_read_handler("batches", read_handler, (void *) 2);
+  add_read_handler("messages", read_handler, (void *) 3);
+  add_read_handler("queue_packets", read_handler, (void *) 4);
+  add_read_handler("queue_bytes", read_handler, (void *) 5);
+  add_read_handler("queue_highwater", read_handler, (void *) 6);
+  add_read_handler("queue_drops", read_handler, (void *) 7);
+  add_read_handler("writes", read_handler, (void *) 8);
 }
 
 CLICK_ENDDECLS
@@ -8,6 +8,7 @@
 #include <click/etheraddress.hh>
 #include "../ip/iproutetable.hh"
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <click/handlercall.hh>
 #include "bc_socket.hh"
 CLICK_DECLS
@@ -38,10 +39,15 @@ class EmpSocket : public Element { public:
   bool allowed(IPAddress);
   void close_active(void);
   int write_packet(Packet*);
+  void push_messages(void);
+  void enqueue_packet(Packet*);
+  void flush_queue(void);
+  void clear_queue(void);
 
 protected:
   Task _task;
   Timer _timer;
+  Timer _flush_timer;
 
 private:
   int _fd;	// socket descriptor
@@ -58,6 +64,7 @@ private:
 
   NotifierSignal _signal;	// packet is available to pull()
   WritablePacket *_rq;		// queue to receive pulled packets
+  uint32_t _rq_fill;		// bytes of _rq filled by stream reads
   Packet *_wq;			// queue to store pulled packet for when sendto() blocks
 
   int _family;			// AF_INET or AF_UNIX
@@ -74,6 +81,7 @@ private:
   int _sndbuf;			// maximum socket send buffer in bytes
   int _rcvbuf;			// maximum socket receive buffer in bytes
   int _snaplen;			// maximum received packet length
+  uint32_t _max_msg_len;	// maximum length of a framed stream message
   unsigned _headroom;
   int _nodelay;			// disable Nagle algorithm
   bool _verbose;		// be verbose
@@ -90,6 +98,22 @@ private:
   EtherAddress wtp;
 
   HandlerCall *_reconnect_call_h;
+
+  uint32_t _nb_reads;		// stream reads that returned data
+  uint32_t _nb_batches;		// batches of messages pushed downstream
+  uint32_t _nb_messages;	// complete messages pushed downstream
+
+  // outbound queue for pushed packets on stream sockets, written with
+  // writev() once FLUSH_BYTES are pending or FLUSH_USEC have elapsed
+  Vector<Packet *> _oq;
+  uint32_t _oq_bytes;		// bytes currently queued
+  uint32_t _oq_highwater;	// maximum bytes ever queued
+  bool _oq_blocked;		// waiting for the socket to become writable
+  uint32_t _oq_drops;		// packets dropped because the queue was full
+  uint32_t _nb_writes;		// writev() calls that wrote data
+  uint32_t _flush_bytes;	// flush as soon as this many bytes are queued
+  uint32_t _flush_usec;		// flush at most this long after the first enqueue
+  uint32_t _queue_limit;	// maximum bytes queued before dropping
   
   static String read_handler(Element *, void *);
 
@@ -0,0 +1,150 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * empowerairtimequeuetest.{cc,hh} -- regression test element for
+ * EmpowerAirtimeQueue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "empowerairtimequeuetest.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <clicknet/wifi.h>
+#include "elements/empower/empowerairtimequeue.hh"
+#include "elements/wifi/transmissionpolicies.hh"
+CLICK_DECLS
+
+EmpowerAirtimeQueueTest::EmpowerAirtimeQueueTest()
+    : _aq(0), _tp(0)
+{
+}
+
+int
+EmpowerAirtimeQueueTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh)
+	.read_mp("AQ", ElementCastArg("EmpowerAirtimeQueue"), _aq)
+	.read_mp("TP", ElementCastArg("TransmissionPolicies"), _tp)
+	.complete();
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+static Packet *
+make_frame(EtherAddress dst, uint32_t len)
+{
+    WritablePacket *p = Packet::make(len);
+    memset(p->data(), 0, len);
+    struct click_wifi *w = (struct click_wifi *) p->data();
+    memcpy(w->i_addr1, dst.data(), 6);
+    return p;
+}
+
+int
+EmpowerAirtimeQueueTest::initialize(ErrorHandler *errh)
+{
+    const unsigned char a_data[] = { 0, 0, 0, 0, 0, 1 };
+    const unsigned char b_data[] = { 0, 0, 0, 0, 0, 2 };
+    EtherAddress a(a_data), b(b_data);
+
+    // a sends at 6 Mbps, b at 54 Mbps
+    Vector<int> slow, fast, ht;
+    slow.push_back(12);
+    fast.push_back(108);
+    _tp->insert(a, slow, ht);
+    _tp->insert(b, fast, ht);
+
+    _aq->add_station(a, 1000);
+    _aq->add_station(b, 1000);
+
+    for (int i = 0; i < 10; i++)
+	_aq->push(0, make_frame(a, 1000));
+    for (int i = 0; i < 10; i++)
+	_aq->push(0, make_frame(b, 1000));
+
+    // a frame of a takes about five times the airtime of a frame of b,
+    // so b sends three or four frames for each frame of a until it drains
+    StringAccum order;
+    while (Packet *p = _aq->pull(0)) {
+	struct click_wifi *w = (struct click_wifi *) p->data();
+	order << (EtherAddress(w->i_addr1) == a ? 'a' : 'b');
+	p->kill();
+    }
+    CHECK(order.take_string() == "abbbbabbbabbbaaaaaaa");
+
+    AirtimeStation sa_stats, sb_stats;
+    CHECK(_aq->station_stats(a, sa_stats));
+    CHECK(_aq->station_stats(b, sb_stats));
+    CHECK(sa_stats._packets == 10 && sb_stats._packets == 10);
+    CHECK(sa_stats._airtime > 4 * sb_stats._airtime);
+    CHECK(sa_stats._length == 0 && !sa_stats._active);
+
+    // stations that are not LVAPs share the default queue
+    const unsigned char c_data[] = { 0, 0, 0, 0, 0, 3 };
+    EtherAddress c(c_data);
+    AirtimeStation sc_stats;
+    CHECK(!_aq->station_stats(c, sc_stats));
+    _aq->push(0, make_frame(c, 100));
+    _aq->push(0, make_frame(EtherAddress::make_broadcast(), 100));
+    int n = 0;
+    while (Packet *p = _aq->pull(0)) {
+	n++;
+	p->kill();
+    }
+    CHECK(n == 2);
+
+    _aq->remove_station(a);
+    _aq->remove_station(b);
+    CHECK(!_aq->station_stats(a, sa_stats));
+
+    // sojourn histogram, four bins per power of two
+    for (uint32_t usec = 0; usec < 4; usec++) {
+	CHECK(SojournHistogram::bin(usec) == (int) usec);
+	CHECK(SojournHistogram::bound(usec) == usec);
+    }
+    CHECK(SojournHistogram::bin(4) == 4);
+    CHECK(SojournHistogram::bin(8) == 8);
+    CHECK(SojournHistogram::bin(9) == 8);
+    CHECK(SojournHistogram::bin(15) == 11);
+    CHECK(SojournHistogram::bin(16) == 12);
+    CHECK(SojournHistogram::bound(8) == 9);
+    CHECK(SojournHistogram::bound(12) == 19);
+    CHECK(SojournHistogram::bin(0xFFFFFFFFU) == SojournHistogram::NB_BINS - 1);
+    CHECK(SojournHistogram::bound(SojournHistogram::NB_BINS - 1) == (1U << 25) - 1);
+
+    // every value falls in the bin whose bounds enclose it
+    for (uint32_t usec = 0; usec < (1 << 25); usec = usec * 9 / 8 + 1) {
+	int bin = SojournHistogram::bin(usec);
+	CHECK(usec <= SojournHistogram::bound(bin));
+	CHECK(bin == 0 || usec > SojournHistogram::bound(bin - 1));
+    }
+
+    SojournHistogram h;
+    CHECK(h.percentile(50) == 0);
+    for (uint32_t usec = 1; usec <= 100; usec++)
+	h.add(usec);
+    CHECK(h._count == 100);
+    CHECK(h.percentile(50) == 55);
+    CHECK(h.percentile(90) == 95);
+    CHECK(h.percentile(99) == 111);
+    CHECK(h.percentile(100) == 111);
+    h.reset();
+    CHECK(h._count == 0 && h.percentile(99) == 0);
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(EmpowerAirtimeQueue)
+EXPORT_ELEMENT(EmpowerAirtimeQueueTest)
@@ -0,0 +1,46 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_EMPOWERAIRTIMEQUEUETEST_HH
+#define CLICK_EMPOWERAIRTIMEQUEUETEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+class EmpowerAirtimeQueue;
+class TransmissionPolicies;
+
+/*
+=c
+
+EmpowerAirtimeQueueTest(AQ, TP)
+
+=s test
+
+runs regression tests for EmpowerAirtimeQueue
+
+=d
+
+EmpowerAirtimeQueueTest runs regression tests for the empty
+EmpowerAirtimeQueue AQ at initialization time: the deficit round robin order
+of two stations sending at different rates, and the bins and percentiles of
+the sojourn time histogram. TP must be the TransmissionPolicies element of
+the Minstrel given to AQ; AQ must have CoDel disabled. It does not route
+packets.
+
+*/
+
+class EmpowerAirtimeQueueTest : public Element { public:
+
+    EmpowerAirtimeQueueTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "EmpowerAirtimeQueueTest"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+  private:
+
+    EmpowerAirtimeQueue *_aq;
+    TransmissionPolicies *_tp;
+
+};
+
+CLICK_ENDDECLS
+#endif
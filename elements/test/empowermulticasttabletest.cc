@@ -0,0 +1,116 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * empowermulticasttabletest.{cc,hh} -- regression test element for
+ * EmpowerMulticastTable
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "empowermulticasttabletest.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include "elements/empower/empowermulticasttable.hh"
+CLICK_DECLS
+
+EmpowerMulticastTableTest::EmpowerMulticastTableTest()
+    : _mtbl(0)
+{
+}
+
+int
+EmpowerMulticastTableTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh)
+	.read_mp("MTBL", ElementCastArg("EmpowerMulticastTable"), _mtbl)
+	.complete();
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+typedef Vector<EmpowerMulticastTable::EmpowerMulticastReceiver> Receivers;
+
+static bool
+has_receiver(Receivers *r, EtherAddress sta)
+{
+    int n = 0;
+    for (int i = 0; i < r->size(); i++)
+	if ((*r)[i].sta == sta)
+	    n++;
+    return n == 1;
+}
+
+int
+EmpowerMulticastTableTest::initialize(ErrorHandler *errh)
+{
+    const unsigned char a_data[] = { 0, 0, 0, 0, 0, 1 };
+    const unsigned char b_data[] = { 0, 0, 0, 0, 0, 2 };
+    const unsigned char c_data[] = { 0, 0, 0, 0, 0, 3 };
+    EtherAddress a(a_data), b(b_data), c(c_data);
+
+    // 224.1.1.1 and 225.1.1.1 both map to 01:00:5e:01:01:01
+    IPAddress g1(String("224.1.1.1")), g2(String("225.1.1.1")), g3(String("239.1.1.2"));
+    EtherAddress mac = _mtbl->ip_mcast_addr_to_mac(g1);
+    CHECK(mac == _mtbl->ip_mcast_addr_to_mac(g2));
+    CHECK(mac != _mtbl->ip_mcast_addr_to_mac(g3));
+    CHECK(_mtbl->getIGMPreceivers(mac) == 0);
+
+    CHECK(_mtbl->addgroup(g1));
+    CHECK(!_mtbl->addgroup(g1));
+    CHECK(_mtbl->addgroup(g2));
+    CHECK(_mtbl->addgroup(g3));
+    CHECK(_mtbl->joingroup(a, g1));
+    CHECK(_mtbl->joingroup(b, g2));
+    CHECK(_mtbl->joingroup(c, g1));
+    CHECK(_mtbl->joingroup(c, g2));
+    CHECK(!_mtbl->joingroup(c, g2));
+    CHECK(_mtbl->joingroup(a, g3));
+
+    // receivers of every ip group of the mac address, each station once
+    Receivers *r = _mtbl->getIGMPreceivers(mac);
+    CHECK(r && r->size() == 3);
+    CHECK(has_receiver(r, a) && has_receiver(r, b) && has_receiver(r, c));
+    r = _mtbl->getIGMPreceivers(_mtbl->ip_mcast_addr_to_mac(g3));
+    CHECK(r && r->size() == 1 && has_receiver(r, a));
+
+    // c is still in 225.1.1.1
+    CHECK(_mtbl->leavegroup(c, g1));
+    r = _mtbl->getIGMPreceivers(mac);
+    CHECK(r && r->size() == 3);
+    CHECK(!_mtbl->leavegroup(c, g1));
+
+    // 224.1.1.1 is gone with its last receiver
+    CHECK(_mtbl->leavegroup(a, g1));
+    CHECK(!_mtbl->multicastgroups.get_pointer(g1));
+    r = _mtbl->getIGMPreceivers(mac);
+    CHECK(r && r->size() == 2);
+    CHECK(has_receiver(r, b) && has_receiver(r, c));
+
+    CHECK(_mtbl->leaveallgroups(c));
+    r = _mtbl->getIGMPreceivers(mac);
+    CHECK(r && r->size() == 1 && has_receiver(r, b));
+    CHECK(!_mtbl->sta_groups.get_pointer(c));
+
+    CHECK(_mtbl->leaveallgroups(a));
+    CHECK(_mtbl->getIGMPreceivers(_mtbl->ip_mcast_addr_to_mac(g3)) == 0);
+    CHECK(_mtbl->leavegroup(b, g2));
+    CHECK(_mtbl->getIGMPreceivers(mac) == 0);
+    CHECK(_mtbl->multicastgroups.size() == 0);
+    CHECK(_mtbl->mac_groups.size() == 0);
+    CHECK(_mtbl->sta_groups.size() == 0);
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(EmpowerMulticastTable)
+EXPORT_ELEMENT(EmpowerMulticastTableTest)
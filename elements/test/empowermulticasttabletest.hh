@@ -0,0 +1,41 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_EMPOWERMULTICASTTABLETEST_HH
+#define CLICK_EMPOWERMULTICASTTABLETEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+class EmpowerMulticastTable;
+
+/*
+=c
+
+EmpowerMulticastTableTest(MTBL)
+
+=s test
+
+runs regression tests for EmpowerMulticastTable
+
+=d
+
+EmpowerMulticastTableTest runs regression tests for the group and receiver
+indexes of the empty EmpowerMulticastTable MTBL at initialization time. It
+does not route packets.
+
+*/
+
+class EmpowerMulticastTableTest : public Element { public:
+
+    EmpowerMulticastTableTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "EmpowerMulticastTableTest"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+  private:
+
+    EmpowerMulticastTable *_mtbl;
+
+};
+
+CLICK_ENDDECLS
+#endif
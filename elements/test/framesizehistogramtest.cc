@@ -0,0 +1,98 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * framesizehistogramtest.{cc,hh} -- regression test element for
+ * FrameSizeHistogram
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "framesizehistogramtest.hh"
+#include <click/error.hh>
+#include "elements/wifi/transmissionpolicy.hh"
+CLICK_DECLS
+
+FrameSizeHistogramTest::FrameSizeHistogramTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+int
+FrameSizeHistogramTest::initialize(ErrorHandler *errh)
+{
+    FrameSizeHistogram h;
+
+    // linear, 64 bytes per bin
+    CHECK(h.nb_bins() == COUNTERS_MAX_BINS);
+    CHECK(h.bin(0) == 0);
+    CHECK(h.bin(63) == 0);
+    CHECK(h.bin(64) == 1);
+    CHECK(h.bin(1500) == 23);
+    CHECK(h.bin(65535) == COUNTERS_MAX_BINS - 1);
+    CHECK(h.bin_size(23) == 1472);
+    CHECK(h.nb_entries() == 0);
+
+    h.update(1480);
+    h.update(1500);
+    h.update(1530);
+    CHECK(h.count(23) == 3);
+    CHECK(h.mean_size(23) == 1503);
+    CHECK(h.nb_entries() == 1);
+
+    // empty bins report their lower bound
+    CHECK(h.mean_size(22) == 1408);
+
+    // the last bin also collects the larger frames
+    h.update(5000);
+    h.update(6000);
+    CHECK(h.count(COUNTERS_MAX_BINS - 1) == 2);
+    CHECK(h.mean_size(COUNTERS_MAX_BINS - 1) == 5500);
+    CHECK(h.nb_entries() == 2);
+
+    h.reset();
+    CHECK(h.count(23) == 0);
+    CHECK(h.nb_entries() == 0);
+
+    h.configure(COUNTERS_BINS_LINEAR, 100);
+    CHECK(h.bin(99) == 0);
+    CHECK(h.bin(100) == 1);
+    CHECK(h.bin_size(15) == 1500);
+
+    // log2, bin i counts [2^i, 2^(i+1))
+    h.configure(COUNTERS_BINS_LOG2, 0);
+    CHECK(h.nb_bins() == 16);
+    CHECK(h.bin(0) == 0);
+    CHECK(h.bin(1) == 0);
+    CHECK(h.bin(2) == 1);
+    CHECK(h.bin(3) == 1);
+    CHECK(h.bin(1023) == 9);
+    CHECK(h.bin(1024) == 10);
+    CHECK(h.bin(1500) == 10);
+    CHECK(h.bin(65535) == 15);
+    CHECK(h.bin_size(0) == 0);
+    CHECK(h.bin_size(10) == 1024);
+
+    h.update(1100);
+    h.update(1500);
+    h.update(60);
+    CHECK(h.count(10) == 2);
+    CHECK(h.mean_size(10) == 1300);
+    CHECK(h.count(5) == 1);
+    CHECK(h.mean_size(5) == 60);
+    CHECK(h.nb_entries() == 2);
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(FrameSizeHistogramTest)
@@ -0,0 +1,35 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FRAMESIZEHISTOGRAMTEST_HH
+#define CLICK_FRAMESIZEHISTOGRAMTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FrameSizeHistogramTest()
+
+=s test
+
+runs regression tests for FrameSizeHistogram
+
+=d
+
+FrameSizeHistogramTest runs regression tests for the linear and log2 bins of
+the FrameSizeHistogram kept by TransmissionPolicies at initialization time.
+It does not route packets.
+
+*/
+
+class FrameSizeHistogramTest : public Element { public:
+
+    FrameSizeHistogramTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "FrameSizeHistogramTest"; }
+
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,105 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * summarytriggertest.{cc,hh} -- regression test element for SummaryTrigger
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "summarytriggertest.hh"
+#include <click/error.hh>
+#include "elements/empower/summary_trigger.hh"
+CLICK_DECLS
+
+SummaryTriggerTest::SummaryTriggerTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+static void
+add_frames(SummaryTrigger &st, int first, int n)
+{
+    for (int seq = first; seq < first + n; seq++)
+	st.add_frame(Frame(EtherAddress(), EtherAddress(), 0, 0, seq, -50, 2, 0, 0, 100, 0, false, 0));
+}
+
+int
+SummaryTriggerTest::initialize(ErrorHandler *errh)
+{
+    // ring of 4 frames, the oldest are overwritten
+    SummaryTrigger ring(0, EtherAddress::make_broadcast(), 1, -1, 1000, 4, 1, false, 0, 0);
+    add_frames(ring, 0, 3);
+    CHECK(ring.nb_frames() == 3);
+    CHECK(ring._dropped == 0);
+    add_frames(ring, 3, 3);
+    CHECK(ring.nb_frames() == 4);
+    CHECK(ring._dropped == 2);
+    CHECK(ring.frame(0)._seq == 2);
+    CHECK(ring.frame(1)._seq == 3);
+    CHECK(ring.frame(2)._seq == 4);
+    CHECK(ring.frame(3)._seq == 5);
+
+    // a new period starts from an empty ring, the drops are totalled
+    ring.clear_frames();
+    CHECK(ring.nb_frames() == 0);
+    CHECK(ring._dropped == 0);
+    CHECK(ring._total_dropped == 2);
+    add_frames(ring, 10, 5);
+    CHECK(ring.frame(0)._seq == 11);
+    CHECK(ring.frame(3)._seq == 14);
+    CHECK(ring._dropped == 1);
+    ring.clear_frames();
+    CHECK(ring._total_dropped == 3);
+
+    // one frame every 3, the others count as dropped
+    SummaryTrigger sampled(0, EtherAddress::make_broadcast(), 2, -1, 1000, 4, 3, false, 0, 0);
+    add_frames(sampled, 0, 7);
+    CHECK(sampled.nb_frames() == 3);
+    CHECK(sampled._dropped == 4);
+    CHECK(sampled.frame(0)._seq == 0);
+    CHECK(sampled.frame(1)._seq == 3);
+    CHECK(sampled.frame(2)._seq == 6);
+
+    // sampling and overwriting together
+    SummaryTrigger both(0, EtherAddress::make_broadcast(), 3, -1, 1000, 2, 2, false, 0, 0);
+    add_frames(both, 0, 10);
+    CHECK(both.nb_frames() == 2);
+    CHECK(both._dropped == 8);
+    CHECK(both.frame(0)._seq == 6);
+    CHECK(both.frame(1)._seq == 8);
+
+    // reservoir: the first frames fill the ring in order, then every
+    // frame replaces at most one random slot
+    SummaryTrigger reservoir(0, EtherAddress::make_broadcast(), 4, -1, 1000, 4, 1, true, 0, 0);
+    add_frames(reservoir, 0, 4);
+    CHECK(reservoir.nb_frames() == 4);
+    CHECK(reservoir._dropped == 0);
+    for (int i = 0; i < 4; i++)
+	CHECK(reservoir.frame(i)._seq == i);
+    add_frames(reservoir, 4, 96);
+    CHECK(reservoir.nb_frames() == 4);
+    CHECK(reservoir._dropped == 96);
+    for (int i = 0; i < 4; i++) {
+	CHECK(reservoir.frame(i)._seq < 100);
+	for (int j = 0; j < i; j++)
+	    CHECK(reservoir.frame(i)._seq != reservoir.frame(j)._seq);
+    }
+    reservoir.clear_frames();
+    CHECK(reservoir._total_dropped == 96);
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(SummaryTrigger)
+EXPORT_ELEMENT(SummaryTriggerTest)
@@ -0,0 +1,35 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SUMMARYTRIGGERTEST_HH
+#define CLICK_SUMMARYTRIGGERTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SummaryTriggerTest()
+
+=s test
+
+runs regression tests for SummaryTrigger
+
+=d
+
+SummaryTriggerTest runs regression tests for the frame ring, the sampling and
+the reservoir mode of the summary triggers at initialization time. It does
+not route packets.
+
+*/
+
+class SummaryTriggerTest : public Element { public:
+
+    SummaryTriggerTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "SummaryTriggerTest"; }
+
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -36,31 +36,22 @@ Minstrel::Minstrel()
 Minstrel::~Minstrel() {
 }
 
+void Minstrel::take_state(Element *e, ErrorHandler *)
+{
+	Minstrel *q = (Minstrel *) e->cast("Minstrel");
+	if (!q) return;
+	_neighbors.swap(q->_neighbors);
+}
+
 void Minstrel::run_timer(Timer *)
 {
 	for (MinstrelIter iter = _neighbors.begin(); iter.live(); iter++) {
 		MinstrelDstInfo *nfo = &iter.value();
 		int max_tp = 0, index_max_tp = 0, index_max_tp2 = 0;
 		int max_prob = 0, index_max_prob = 0;
-		uint32_t usecs;
 		int i;
 		uint32_t p;
-		for (i = 0; i < nfo->rates.size(); i++) {
-			if (_transm_time.find(nfo->rates[i]) == _transm_time.end()) {
-				if (nfo->ht)
-					usecs = calc_usecs_wifi_packet_ht(1500, nfo->rates[i], 0);
-				else
-					usecs = calc_usecs_wifi_packet(1500, nfo->rates[i], 0);
-
-				_transm_time.set(nfo->rates[i], usecs);
-			}
-			else
-			{
-				usecs = _transm_time.get(nfo->rates[i]);
-			}
-			if (!usecs) {
-				usecs = 1000000;
-			}
+		for (i = 0; i < nfo->nb_rates; i++) {
 			/* To avoid rounding issues, probabilities scale from 0 (0%)
 			 * to 18000 (100%) */
 			if (nfo->attempts[i]) {
@@ -70,12 +61,15 @@ void Minstrel::run_timer(Timer *)
 				nfo->cur_prob[i] = p;
 				p = ((p * (100 - _ewma_level)) + (nfo->probability[i] * _ewma_level)) / 100;
 				nfo->probability[i] = p;
-				nfo->cur_tp[i] = p * (1000000 / usecs);
+				nfo->cur_tp[i] = p * (1000000 / nfo->usecs[i]);
 			}
-			nfo->last_successes[i] = nfo->successes[i];
-			nfo->last_attempts[i] = nfo->attempts[i];
-			nfo->successes[i] = 0;
-			nfo->attempts[i] = 0;
+		}
+		/* reset the per-period counters and refresh the sampling limits */
+		memcpy(nfo->last_successes, nfo->successes, sizeof(nfo->successes));
+		memcpy(nfo->last_attempts, nfo->attempts, sizeof(nfo->attempts));
+		memset(nfo->successes, 0, sizeof(nfo->successes));
+		memset(nfo->attempts, 0, sizeof(nfo->attempts));
+		for (i = 0; i < nfo->nb_rates; i++) {
 			/* Sample less often below the 10% chance of success.
 			 * Sample less often above the 95% chance of success. */
 			if ((nfo->probability[i] > 17100) || (nfo->probability[i] < 1800)) {
@@ -84,7 +78,7 @@ void Minstrel::run_timer(Timer *)
 				nfo->sample_limit[i] = -1;
 			}
 		}
-		for (i = 0; i < nfo->rates.size(); i++) {
+		for (i = 0; i < nfo->nb_rates; i++) {
 			if (max_tp < nfo->cur_tp[i]) {
 				index_max_tp = i;
 				max_tp = nfo->cur_tp[i];
@@ -95,7 +89,7 @@ void Minstrel::run_timer(Timer *)
 			}
 		}
 		max_tp = 0;
-		for (i = 0; i < nfo->rates.size(); i++) {
+		for (i = 0; i < nfo->nb_rates; i++) {
 			if (i == index_max_tp) {
 				continue;
 			}
@@ -172,6 +166,23 @@ void Minstrel::process_feedback(Packet *p_in) {
 	return;
 }
 
+MinstrelDstInfo * Minstrel::insert_neighbor(EtherAddress dst, TxPolicyInfo * txp) {
+	bool ht = txp->_ht_mcs.size();
+	const Vector<int> &rates = ht ? txp->_ht_mcs : txp->_mcs;
+	_neighbors.insert(dst, MinstrelDstInfo(dst, rates, ht));
+	MinstrelDstInfo *nfo = _neighbors.findp(dst);
+	nfo->generation = txp->_generation;
+	if (nfo->nb_rates == MINSTREL_MAX_RATES && rates.size() > MINSTREL_MAX_RATES) {
+		click_chatter("%{element} :: %s :: %s has %d rates, only the first %d are used",
+				this,
+				__func__,
+				dst.unparse().c_str(),
+				rates.size(),
+				MINSTREL_MAX_RATES);
+	}
+	return nfo;
+}
+
 void Minstrel::assign_rate(Packet *p_in)
 {
 
@@ -185,16 +196,17 @@ void Minstrel::assign_rate(Packet *p_in)
 
 	memset((void*)ceh, 0, sizeof(struct click_wifi_extra));
 
-	TxPolicyInfo * tx_policy = _tx_policies->supported(dst);
+	/* resolve the policy once: a single hash probe, no copies */
+	TxPolicyInfo * tx_policy = dst ? _tx_policies->supported(dst) : 0;
+	TxPolicyInfo * policy = tx_policy ? tx_policy : _tx_policies->default_tx_policy();
+
 	if (dst.is_group()) {
 		ceh->flags |= WIFI_EXTRA_TX_NOACK;
 		if(!tx_policy || tx_policy->_ht_mcs.size() == 0) {
-			Vector<int> rates = _tx_policies->lookup(dst)->_mcs;
-			ceh->rate = (rates.size()) ? rates[0] : 2;
+			ceh->rate = policy->_first_mcs;
 		}
 		else {
-			Vector<int> ht_rates = _tx_policies->lookup(dst)->_ht_mcs;
-			ceh->rate = (ht_rates.size()) ? ht_rates[0] : 2;
+			ceh->rate = policy->_first_ht_mcs;
 			ceh->flags |= WIFI_EXTRA_MCS;
 		}
 
@@ -217,8 +229,7 @@ void Minstrel::assign_rate(Packet *p_in)
 		if (subtype == WIFI_FC0_SUBTYPE_BEACON || subtype == WIFI_FC0_SUBTYPE_PROBE_RESP) {
 			ceh->flags |= WIFI_EXTRA_TX_NOACK;
 		}
-		Vector<int> rates = _tx_policies->lookup(dst)->_mcs;
-		ceh->rate = (rates.size()) ? rates[0] : 2;
+		ceh->rate = policy->_first_mcs;
 		ceh->rate1 = -1;
 		ceh->rate2 = -1;
 		ceh->rate3 = -1;
@@ -231,38 +242,32 @@ void Minstrel::assign_rate(Packet *p_in)
 
 	MinstrelDstInfo *nfo = _neighbors.findp(dst);
 
-	if (!nfo || !nfo->rates.size()) {
+	if (tx_policy && (!nfo || (!nfo->nb_rates && nfo->generation != tx_policy->_generation))) {
 		if (_debug) {
 			click_chatter("%{element} :: %s :: adding %s",
 					this, 
 					__func__,
 					dst.unparse().c_str());
 		}
-		if (!tx_policy) {
-			if (_debug) {
-				click_chatter("%{element} :: %s :: rate info not found for %s",
-						this, 
-						__func__,
-						dst.unparse().c_str());
-			}
-			Vector<int> rates = _tx_policies->lookup(dst)->_mcs;
-			ceh->rate = (rates.size()) ? rates[0] : 2;
-			ceh->rate1 = -1;
-			ceh->rate2 = -1;
-			ceh->rate3 = -1;
-			ceh->max_tries = WIFI_MAX_RETRIES + 1;
-			ceh->max_tries1 = 0;
-			ceh->max_tries2 = 0;
-			ceh->max_tries3 = 0;
-			return;
-		}
-		if (tx_policy->_ht_mcs.size()) {
-			_neighbors.insert(dst, MinstrelDstInfo(dst, tx_policy->_ht_mcs, true));
-			nfo = _neighbors.findp(dst);
-		} else {
-			_neighbors.insert(dst, MinstrelDstInfo(dst, tx_policy->_mcs, false));
-			nfo = _neighbors.findp(dst);
+		nfo = insert_neighbor(dst, tx_policy);
+	}
+
+	if (!nfo || !nfo->nb_rates) {
+		if (_debug) {
+			click_chatter("%{element} :: %s :: rate info not found for %s",
+					this, 
+					__func__,
+					dst.unparse().c_str());
 		}
+		ceh->rate = policy->_first_mcs;
+		ceh->rate1 = -1;
+		ceh->rate2 = -1;
+		ceh->rate3 = -1;
+		ceh->max_tries = WIFI_MAX_RETRIES + 1;
+		ceh->max_tries1 = 0;
+		ceh->max_tries2 = 0;
+		ceh->max_tries3 = 0;
+		return;
 	}
 
 	int ndx;
@@ -279,8 +284,8 @@ void Minstrel::assign_rate(Packet *p_in)
 			nfo->sample_count = 0;
 			nfo->packet_count = 0;
 		}
-		if (nfo->rates.size() > 0) {
-			int sample_ndx = click_random(0, nfo->rates.size() - 1);
+		if (nfo->nb_rates > 0) {
+			int sample_ndx = click_random(0, nfo->nb_rates - 1);
 			if (nfo->sample_limit[sample_ndx] != 0) {
 				sample = true;
 				ndx = sample_ndx;
@@ -19,77 +19,92 @@ CLICK_DECLS
  */
 
 
+#define MINSTREL_MAX_RATES 32
+
+/* Per-station rate statistics. All the per-rate counters live in fixed-size
+ * arrays inside the entry, so a station is a single contiguous block and a
+ * rate code is mapped to its index with a table lookup instead of a scan.
+ * Only the first MINSTREL_MAX_RATES distinct rates of the policy are used,
+ * rates outside 0-255 are skipped. An entry with no usable rates is kept
+ * until the station's policy changes, see generation. */
 struct MinstrelDstInfo {
 public:
 	EtherAddress eth;
-	Vector<int> rates;
-	Vector<int> successes;
-	Vector<int> attempts;
-	Vector<int> last_successes;
-	Vector<int> last_attempts;
-	Vector<int> hist_successes;
-	Vector<int> hist_attempts;
-	Vector<int> cur_prob;
-	Vector<int> cur_tp;
-	Vector<int> probability;
-	Vector<int> sample_limit;
+	int nb_rates;
+	int rates[MINSTREL_MAX_RATES];
+	uint32_t usecs[MINSTREL_MAX_RATES];
+	int successes[MINSTREL_MAX_RATES];
+	int attempts[MINSTREL_MAX_RATES];
+	int last_successes[MINSTREL_MAX_RATES];
+	int last_attempts[MINSTREL_MAX_RATES];
+	int hist_successes[MINSTREL_MAX_RATES];
+	int hist_attempts[MINSTREL_MAX_RATES];
+	int cur_prob[MINSTREL_MAX_RATES];
+	int cur_tp[MINSTREL_MAX_RATES];
+	int probability[MINSTREL_MAX_RATES];
+	int sample_limit[MINSTREL_MAX_RATES];
+	int8_t rate_to_index[256];
 	int packet_count;
 	int sample_count;
 	int max_tp_rate;
 	int max_tp_rate2;
 	int max_prob_rate;
 	bool ht;
+	uint32_t generation; // TxPolicyInfo::_generation the rates were taken from
 	MinstrelDstInfo() {
 		eth = EtherAddress();
-		rates = Vector<int>();
-		successes = Vector<int>();
-		attempts = Vector<int>();
-		last_successes = Vector<int>();
-		last_attempts = Vector<int>();
-		hist_successes = Vector<int>();
-		hist_attempts = Vector<int>();
-		cur_prob = Vector<int>();
-		cur_tp = Vector<int>();
-		probability = Vector<int>();
-		sample_limit = Vector<int>();
+		nb_rates = 0;
+		memset(rate_to_index, -1, sizeof(rate_to_index));
 		packet_count = 0;
 		sample_count = 0;
 		max_tp_rate = 0;
 		max_tp_rate2 = 0;
 		max_prob_rate = 0;
 		ht = false;
+		generation = 0;
 	}
-	MinstrelDstInfo(EtherAddress neighbor, Vector<int> supported, bool ht_rates) {
+	MinstrelDstInfo(EtherAddress neighbor, const Vector<int> &supported, bool ht_rates) {
 		eth = neighbor;
-		for (int i = 0; i < supported.size(); i++) {
-			rates.push_back(supported[i]);
+		ht = ht_rates;
+		generation = 0;
+		nb_rates = 0;
+		memset(rate_to_index, -1, sizeof(rate_to_index));
+		for (int i = 0; i < supported.size() && nb_rates < MINSTREL_MAX_RATES; i++) {
+			int rate = supported[i];
+			if (rate < 0 || rate > 255 || rate_to_index[rate] >= 0) {
+				continue;
+			}
+			rates[nb_rates] = rate;
+			rate_to_index[rate] = nb_rates;
+			if (ht)
+				usecs[nb_rates] = calc_usecs_wifi_packet_ht(1500, rate, 0);
+			else
+				usecs[nb_rates] = calc_usecs_wifi_packet(1500, rate, 0);
+			if (!usecs[nb_rates]) {
+				usecs[nb_rates] = 1000000;
+			}
+			nb_rates++;
+		}
+		memset(successes, 0, sizeof(successes));
+		memset(attempts, 0, sizeof(attempts));
+		memset(last_successes, 0, sizeof(last_successes));
+		memset(last_attempts, 0, sizeof(last_attempts));
+		memset(hist_successes, 0, sizeof(hist_successes));
+		memset(hist_attempts, 0, sizeof(hist_attempts));
+		memset(cur_prob, 0, sizeof(cur_prob));
+		memset(cur_tp, 0, sizeof(cur_tp));
+		memset(probability, 0, sizeof(probability));
+		for (int i = 0; i < MINSTREL_MAX_RATES; i++) {
+			sample_limit[i] = -1;
 		}
-		successes = Vector<int>(supported.size(), 0);
-		attempts = Vector<int>(supported.size(), 0);
-		last_successes = Vector<int>(supported.size(), 0);
-		last_attempts = Vector<int>(supported.size(), 0);
-		hist_successes = Vector<int>(supported.size(), 0);
-		hist_attempts = Vector<int>(supported.size(), 0);
-		cur_prob = Vector<int>(supported.size(), 0);
-		cur_tp = Vector<int>(supported.size(), 0);
-		probability = Vector<int>(supported.size(), 0);
-		sample_limit = Vector<int>(supported.size(), -1);
 		packet_count = 0;
 		sample_count = 0;
 		max_tp_rate = 0;
 		max_tp_rate2 = 0;
 		max_prob_rate = 0;
-		ht = ht_rates;
 	}
 	int rate_index(int rate) {
-		int ndx = -1;
-		for (int x = 0; x < rates.size(); x++) {
-			if (rate == rates[x]) {
-				ndx = x;
-				break;
-			}
-		}
-		return (ndx == rates.size()) ? -1 : ndx;
+		return (rate < 0 || rate > 255) ? -1 : rate_to_index[rate];
 	}
 	void add_result(int rate, int tries, int success) {
 		int ndx = rate_index(rate);
@@ -104,7 +119,7 @@ public:
 		char buffer[4096];
 		sa << eth << "\n";
 		sa << "rate    throughput    ewma prob    this prob    this success (attempts)    success    attempts\n";
-		for (int i = 0; i < rates.size(); i++) {
+		for (int i = 0; i < nb_rates; i++) {
 			tp = cur_tp[i] / ((18000 << 10) / 96);
 			prob = cur_prob[i] / 18;
 			eprob = probability[i] / 18;
@@ -150,9 +165,6 @@ public:
 typedef HashMap<EtherAddress, MinstrelDstInfo> MinstrelNeighborTable;
 typedef MinstrelNeighborTable::iterator MinstrelIter;
 
-typedef HashTable<uint8_t, uint32_t> TTime;
-typedef TTime::iterator TTimeIter;
-
 class Minstrel : public Element { public:
 
 	Minstrel();
@@ -165,6 +177,7 @@ class Minstrel : public Element { public:
 
 	int initialize(ErrorHandler *);
 	int configure(Vector<String> &, ErrorHandler *);
+	void take_state(Element *, ErrorHandler *);
 	void run_timer(Timer *);
 
 	void push (int, Packet *);
@@ -181,24 +194,13 @@ class Minstrel : public Element { public:
 	TransmissionPolicies * tx_policies() { return _tx_policies; }
 	bool forget_station(EtherAddress addr) { return _neighbors.erase(addr); }
 
-	MinstrelDstInfo * insert_neighbor(EtherAddress dst, TxPolicyInfo * txp) {
-		MinstrelDstInfo *nfo;
-		if (txp->_ht_mcs.size()) {
-			_neighbors.insert(dst, MinstrelDstInfo(dst, txp->_ht_mcs, true));
-			nfo = _neighbors.findp(dst);
-		} else {
-			_neighbors.insert(dst, MinstrelDstInfo(dst, txp->_mcs, false));
-			nfo = _neighbors.findp(dst);
-		}
-		return nfo;
-	}
+	MinstrelDstInfo * insert_neighbor(EtherAddress, TxPolicyInfo *);
 
 private:
 
 	MinstrelNeighborTable _neighbors;
 	TransmissionPolicies * _tx_policies;
 	Timer _timer;
-	TTime _transm_time;
 
 	unsigned _lookaround_rate;
 	unsigned _offset;
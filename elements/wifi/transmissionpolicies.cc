@@ -24,7 +24,8 @@
 #include "transmissionpolicies.hh"
 CLICK_DECLS
 
-TransmissionPolicies::TransmissionPolicies() : _default_tx_policy(0) {
+TransmissionPolicies::TransmissionPolicies() : _default_tx_policy(0),
+		_bins_type(COUNTERS_BINS_LINEAR), _bin_width(64), _generation(0) {
 }
 
 TransmissionPolicies::~TransmissionPolicies() {
@@ -53,6 +54,22 @@ int TransmissionPolicies::configure(Vector<String> &conf, ErrorHandler *errh) {
 
 			_default_tx_policy = tx_policy->tx_policy();
 
+		} else if (args[0] == "BINS") {
+
+			if (args[1] == "LINEAR") {
+				_bins_type = COUNTERS_BINS_LINEAR;
+			} else if (args[1] == "LOG2") {
+				_bins_type = COUNTERS_BINS_LOG2;
+			} else {
+				return errh->error("error param %s: must be LINEAR or LOG2", conf[x].c_str());
+			}
+
+		} else if (args[0] == "BIN_WIDTH") {
+
+			if (!IntArg().parse(args[1], _bin_width) || _bin_width < 1 || _bin_width > 1024) {
+				return errh->error("error param %s: must be an integer between 1 and 1024", conf[x].c_str());
+			}
+
 		} else {
 
 			EtherAddress eth;
@@ -68,6 +85,7 @@ int TransmissionPolicies::configure(Vector<String> &conf, ErrorHandler *errh) {
 			}
 
 			_tx_table.insert(eth, tx_policy->tx_policy());
+			_configured.push_back(eth);
 
 		}
 
@@ -76,12 +94,52 @@ int TransmissionPolicies::configure(Vector<String> &conf, ErrorHandler *errh) {
 	if (!_default_tx_policy) {
 		_default_tx_policy = new TxPolicyInfo();
 		_default_tx_policy->_mcs.push_back(2);
+		_default_tx_policy->update_first_rates();
+	}
+
+	_default_tx_policy->set_counters_bins(_bins_type, _bin_width);
+
+	for (TxTableIter it = _tx_table.begin(); it.live(); it++) {
+		it.value()->set_counters_bins(_bins_type, _bin_width);
 	}
 
 	return res;
 
 }
 
+void TransmissionPolicies::take_state(Element *e, ErrorHandler *) {
+
+	TransmissionPolicies *q = (TransmissionPolicies *) e->cast("TransmissionPolicies");
+
+	if (!q) {
+		return;
+	}
+
+	// The policies set at run time were allocated by insert() and move
+	// over with the table. The configured ones belong to the old
+	// TransmissionPolicy elements, so they are replaced by ours.
+	TxTable configured;
+	configured.swap(_tx_table);
+	_tx_table.swap(q->_tx_table);
+
+	for (int i = 0; i < q->_configured.size(); i++) {
+		_tx_table.remove(q->_configured[i]);
+	}
+
+	for (TxTableIter it = configured.begin(); it.live(); it++) {
+		_tx_table.insert(it.key(), it.value());
+	}
+
+	if (q->_bins_type != _bins_type || q->_bin_width != _bin_width) {
+		for (TxTableIter it = _tx_table.begin(); it.live(); it++) {
+			it.value()->set_counters_bins(_bins_type, _bin_width);
+		}
+	}
+
+	_generation = q->_generation + 1;
+
+}
+
 TxPolicyInfo *
 TransmissionPolicies::lookup(EtherAddress eth) {
 
@@ -136,6 +194,7 @@ int TransmissionPolicies::insert(EtherAddress eth, Vector<int> mcs, Vector<int>
 	if (!dst) {
 		_tx_table.insert(eth, new TxPolicyInfo());
 		dst = _tx_table.find(eth);
+		dst->set_counters_bins(_bins_type, _bin_width);
 	}
 
 	dst->_mcs.clear();
@@ -171,6 +230,12 @@ int TransmissionPolicies::insert(EtherAddress eth, Vector<int> mcs, Vector<int>
 		dst->_ht_mcs = ht_mcs;
 	}
 
+	dst->update_first_rates();
+
+	// unique within the table, a policy removed and inserted again does
+	// not get back its old stamp
+	dst->_generation = ++_generation;
+
 	return 0;
 
 }
@@ -21,6 +21,19 @@ Tracks bit-rate capabilities of other stations.
 
 Tracks a list of bitrates other stations are capable of.
 
+Besides the DEFAULT and per-address entries, two optional entries
+configure the frame size histograms kept for every policy:
+
+=over 8
+
+=item BINS
+Either LINEAR or LOG2. Default is LINEAR.
+
+=item BIN_WIDTH
+Width of a linear bin in bytes, between 1 and 1024. Default is 64.
+
+=back 8
+
 =h insert write-only
 Inserts an ethernet address and a list of bitrates to the database.
 
@@ -45,6 +58,7 @@ class TransmissionPolicies : public Element { public:
   const char *port_count() const		{ return PORTS_0_0; }
 
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+  void take_state(Element *, ErrorHandler *);
 
   void add_handlers() CLICK_COLD;
 
@@ -62,6 +76,10 @@ private:
 
   TxTable _tx_table;
   TxPolicyInfo * _default_tx_policy;
+  Vector<EtherAddress> _configured; // entries owned by TransmissionPolicy elements
+  empower_counters_bins_type _bins_type;
+  int _bin_width;
+  uint32_t _generation;		// last TxPolicyInfo::_generation given by insert()
 
   static String read_handler(Element *, void *);
 
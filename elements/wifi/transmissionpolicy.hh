@@ -8,6 +8,7 @@
 #include <click/bighashmap.hh>
 #include <click/straccum.hh>
 #include <click/glue.hh>
+#include <click/integers.hh>
 CLICK_DECLS
 
 /*
@@ -26,8 +27,88 @@ Tracks a list of bitrates other stations are capable of.
 =a BeaconScanner
  */
 
-typedef HashTable<uint16_t, uint32_t> CBytes;
-typedef CBytes::iterator CBytesIter;
+enum empower_counters_bins_type {
+	COUNTERS_BINS_LINEAR = 0x0,
+	COUNTERS_BINS_LOG2 = 0x1,
+};
+
+#define COUNTERS_MAX_BINS 64
+
+/* Frame size histogram with a fixed number of bins. Linear bins are
+ * _width bytes wide, log2 bin i counts frames in [2^i, 2^(i+1)). The
+ * last bin also collects all the larger frames. Every bin also keeps
+ * the bytes it counted, so that it can report the mean frame size. */
+class FrameSizeHistogram {
+public:
+
+	FrameSizeHistogram() {
+		configure(COUNTERS_BINS_LINEAR, 64);
+	}
+
+	void configure(empower_counters_bins_type type, int width) {
+		_type = type;
+		_width = width > 0 ? width : 1;
+		_nb_bins = (type == COUNTERS_BINS_LOG2) ? 16 : COUNTERS_MAX_BINS;
+		reset();
+	}
+
+	void reset() {
+		memset(_bins, 0, sizeof(_bins));
+		memset(_bytes, 0, sizeof(_bytes));
+	}
+
+	void update(uint16_t len) {
+		int b = bin(len);
+		_bins[b]++;
+		_bytes[b] += len;
+	}
+
+	int bin(uint16_t len) const {
+		int b;
+		if (_type == COUNTERS_BINS_LOG2) {
+			b = len ? 32 - ffs_msb((unsigned) len) : 0;
+		} else {
+			b = len / _width;
+		}
+		return b < _nb_bins ? b : _nb_bins - 1;
+	}
+
+	/* smallest frame size counted in bin b */
+	uint16_t bin_size(int b) const {
+		if (_type == COUNTERS_BINS_LOG2) {
+			return b ? (1 << b) : 0;
+		}
+		return b * _width;
+	}
+
+	/* mean size of the frames counted in bin b */
+	uint16_t mean_size(int b) const {
+		return _bins[b] ? _bytes[b] / _bins[b] : bin_size(b);
+	}
+
+	int nb_bins() const { return _nb_bins; }
+	uint32_t count(int b) const { return _bins[b]; }
+
+	/* number of non-empty bins, i.e. of entries on the wire */
+	int nb_entries() const {
+		int n = 0;
+		for (int b = 0; b < _nb_bins; b++) {
+			if (_bins[b]) {
+				n++;
+			}
+		}
+		return n;
+	}
+
+private:
+
+	empower_counters_bins_type _type;
+	int _width;
+	int _nb_bins;
+	uint32_t _bins[COUNTERS_MAX_BINS];
+	uint64_t _bytes[COUNTERS_MAX_BINS];
+
+};
 
 
 enum empower_tx_mcast_type {
@@ -41,20 +122,26 @@ public:
 
 	Vector<int> _mcs;
 	Vector<int> _ht_mcs;
+	int _first_mcs;
+	int _first_ht_mcs;
 	bool _no_ack;
 	empower_tx_mcast_type _tx_mcast;
 	int _ur_mcast_count;
 	int _rts_cts;
-	CBytes _tx;
-	CBytes _rx;
+	uint32_t _generation; // changes whenever the policy is set, lets users cache derived data
+	FrameSizeHistogram _tx;
+	FrameSizeHistogram _rx;
 
 	TxPolicyInfo() {
 		_mcs = Vector<int>();
 		_ht_mcs = Vector<int>();
+		_first_mcs = 2;
+		_first_ht_mcs = 2;
 		_no_ack = false;
 		_tx_mcast = TX_MCAST_DMS;
 		_rts_cts = 2436;
 		_ur_mcast_count = 3;
+		_generation = 0;
 	}
 
 	TxPolicyInfo(Vector<int> mcs, Vector<int> ht_mcs, bool no_ack, empower_tx_mcast_type tx_mcast,
@@ -66,20 +153,28 @@ public:
 		_tx_mcast = tx_mcast;
 		_rts_cts = rts_cts;
 		_ur_mcast_count = ur_mcast_count;
+		_generation = 0;
+		update_first_rates();
+	}
+
+	/* Cache the first legacy/HT rate so that the TX path does not need to
+	 * touch the rate vectors. Must be called after _mcs or _ht_mcs change. */
+	void update_first_rates() {
+		_first_mcs = _mcs.size() ? _mcs[0] : 2;
+		_first_ht_mcs = _ht_mcs.size() ? _ht_mcs[0] : 2;
 	}
 
 	void update_tx(uint16_t len) {
-		if (_tx.find(len) == _tx.end()) {
-			_tx.set(len, 0);
-		}
-		(*_tx.get_pointer(len))++;
+		_tx.update(len);
 	}
 
 	void update_rx(uint16_t len) {
-		if (_rx.find(len) == _rx.end()) {
-			_rx.set(len, 0);
-		}
-		(*_rx.get_pointer(len))++;
+		_rx.update(len);
+	}
+
+	void set_counters_bins(empower_counters_bins_type type, int width) {
+		_tx.configure(type, width);
+		_rx.configure(type, width);
 	}
 
 	String unparse() {
@@ -45,12 +45,14 @@ WifiSeq::configure(Vector<String> &conf, ErrorHandler *errh)
   _offset = 22;
   _bytes = 2;
   _shift = 4;
+  _group_retries = false;
 
   if (Args(conf, this, errh)
       .read("DEBUG", _debug)
       .read("OFFSET", _offset)
       .read("BYTES", _bytes)
       .read("SHIFT", _shift)
+      .read("GROUP_RETRIES", _group_retries)
       .complete() < 0)
     return -1;
 
@@ -67,6 +69,7 @@ void
 WifiSeq::reset()
 {
   _seq = 0;
+  _group_seqs.clear();
 }
 
 Packet *
@@ -77,12 +80,36 @@ WifiSeq::simple_action(Packet *p_in) {
     struct click_wifi_extra *ceh = WIFI_EXTRA_ANNO(p_in);
     ceh->flags |= WIFI_EXTRA_NO_SEQ;
     char *data = (char *)(p->data() + _offset);
+    uint32_t seq = _seq;
+    bool repeat = false;
+    if (_group_retries && p->length() >= sizeof(struct click_wifi)) {
+      struct click_wifi *w = (struct click_wifi *) p->data();
+      EtherAddress dst = EtherAddress(w->i_addr1);
+      if (dst.is_group() && (w->i_fc[0] & WIFI_FC0_TYPE_MASK) == WIFI_FC0_TYPE_DATA) {
+        WifiSeqGroup group(dst, EtherAddress(w->i_addr2));
+        u_int32_t *last = _group_seqs.get_pointer(group);
+        if (w->i_fc[1] & WIFI_FC1_RETRY) {
+          if (last) {
+            seq = *last;
+            repeat = true;
+          }
+        } else if (last) {
+          *last = seq;
+        } else {
+          // the entries only matter until the repeats are out
+          if (_group_seqs.size() >= MAX_GROUPS)
+            _group_seqs.clear();
+          _group_seqs.set(group, seq);
+        }
+      }
+    }
     if (_bytes == 2) {
-      *(u_int16_t *)data = (cpu_to_le16(_seq << _shift));
+      *(u_int16_t *)data = (cpu_to_le16(seq << _shift));
     } else {
-      *(u_int32_t *)data = (cpu_to_le32(_seq << _shift));
+      *(u_int32_t *)data = (cpu_to_le32(seq << _shift));
     }
-    _seq++;
+    if (!repeat)
+      _seq++;
   }
   return p;
 
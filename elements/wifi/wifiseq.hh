@@ -3,6 +3,7 @@
 #include <click/element.hh>
 #include <clicknet/ether.h>
 #include <click/etheraddress.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 
 /*
@@ -30,14 +31,35 @@ How many bytes the sequence number should use. Values can be
 How many bits to shift the sequence number before setting the value in the packet.
 Default is 4.
 
-=back 8
+=item GROUP_RETRIES
+Boolean. If true, a group addressed data frame that arrives with the retry
+bit set is a repeat of the last group data frame sent by the same
+transmitter to the same address and reuses its sequence number, so that
+receivers discard the repeats as duplicates. Default is false.
 
+=back 8
 
 =h seq read/write
 Sets or reads the next sequence number
 
 =a WifiEncap */
 
+// A group address and the transmitter sending to it
+class WifiSeqGroup {
+public:
+  EtherAddress _dst;
+  EtherAddress _ta;
+  WifiSeqGroup() { }
+  WifiSeqGroup(EtherAddress dst, EtherAddress ta) : _dst(dst), _ta(ta) { }
+  inline size_t hashcode() const {
+    return _dst.hashcode() * 31 + _ta.hashcode();
+  }
+};
+
+inline bool operator==(const WifiSeqGroup &a, const WifiSeqGroup &b) {
+  return a._dst == b._dst && a._ta == b._ta;
+}
+
 class WifiSeq : public Element { public:
 
   WifiSeq() CLICK_COLD;
@@ -67,6 +89,11 @@ class WifiSeq : public Element { public:
   u_int32_t _shift;
   u_int32_t _bytes;
 
+  // last sequence number of every group, for GROUP_RETRIES
+  bool _group_retries;
+  HashTable<WifiSeqGroup, u_int32_t> _group_seqs;
+  enum { MAX_GROUPS = 256 };
+
 };
 
 CLICK_ENDDECLS